@@ -28,9 +28,54 @@
 
 #include "getopt.h"
 
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#if !defined(GETOPT_NO_STDIO)
 #include <stdio.h>
+#endif
+
+/* SSE2 is part of every x86-64 target. Scanning aligned blocks reads
+   past the end of arguments, which address sanitizers object to. */
+#if !defined(GETOPT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64)) && \
+  !defined(__SANITIZE_ADDRESS__)
+#if defined(__has_feature)
+#if !__has_feature(address_sanitizer)
+#define GETOPT_SSE2 1
+#endif
+#else
+#define GETOPT_SSE2 1
+#endif
+#endif
+
+#if defined(GETOPT_SSE2)
+#include <emmintrin.h>
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/* Builds may route the spec allocations elsewhere by defining GETOPT_MALLOC
+   and GETOPT_FREE to functions with the signatures of malloc and free. */
+#if defined(GETOPT_MALLOC)
+void* GETOPT_MALLOC(size_t size);
+void GETOPT_FREE(void* ptr);
+#else
+#define GETOPT_MALLOC malloc
+#define GETOPT_FREE free
+#endif
+
+/* Instrumentation, see struct getopt_stats, is compiled in only with
+   GETOPT_INSTRUMENT. */
+#if defined(GETOPT_INSTRUMENT)
+#define GETOPT_COUNT(statement) statement
+#else
+#define GETOPT_COUNT(statement)
+#endif
 
 const char* optarg = NULL;
 int optopt = 0;
@@ -38,281 +83,2107 @@ int optopt = 0;
 int optind = 1;
 int opterr = 1; /* The calling program may prevent the error message by setting opterr to 0. */
 
-static const char* optcursor = NULL;
-static const char *first = NULL;
+/* State behind the non-reentrant getopt() and getopt_long(). The globals
+   above are copied in before and out after every call. */
+static struct getopt_state global_state;
+
+/* Long options are compiled into a trie, so that a name is resolved in
+   time proportional to its length rather than to the number of options.
+   Every node knows how many options share its prefix, which is all that is
+   needed to tell a unique abbreviation from an ambiguous one. The children
+   of a node are adjacent and sorted by character, so the options with a
+   prefix are a range of the options sorted by name. */
+struct getopt_node {
+  int exact;        /* first option whose name ends here, or -1 */
+  int count;        /* number of options with this prefix */
+  int first;        /* first option with this prefix */
+  int begin;        /* position of `first` in getopt_spec.sorted */
+  int children;
+  int num_children;
+  unsigned char c;
+};
+
+/* Short options are compiled into a table of how each character is
+   declared in optstring, see short_option_class(). The spec is parsed
+   through its resolver, which refers back to the tables. */
+struct getopt_spec {
+  struct getopt_resolver resolver;
+  struct getopt_node* nodes;
+  int* sorted;                /* longopts indices, by name */
+  unsigned char shortopts[256];
+};
+
+#if defined(GETOPT_INSTRUMENT)
+/* Counts an event in state->stats and passes it on to state->trace. */
+static void instrument(const struct getopt_state* state, int event,
+  int index, unsigned long value) {
+  struct getopt_stats* stats = state->stats;
+
+  if (stats) {
+    switch (event) {
+    case GETOPT_TRACE_EXCHANGE:
+      ++stats->exchanges;
+      stats->moves += value;
+      break;
+    case GETOPT_TRACE_LOOKUP:
+      ++stats->lookups;
+      stats->comparisons += value;
+      break;
+    case GETOPT_TRACE_ERROR:
+      ++stats->errors[value];
+      break;
+    }
+  }
+
+  if (state->trace)
+    state->trace(state->trace_context, event, index, value);
+}
+#endif
 
-/* rotates argv array */
-static void rotate(const char **argv, int argc) {
-  if (argc <= 1)
+#if defined(GETOPT_SSE2)
+static int lowest_bit(unsigned mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/* Finds the length of s and the offset of its first '=', or the length if
+   there is none, in a single pass: the strlen() and strcspn(s, "=") of a
+   --name=value argument in one. Arguments can be long, e.g. encoded blobs,
+   so with SSE2 16 bytes are compared at a time. The loads are aligned, and
+   so never cross into a page that s does not reach. */
+static size_t scan_argument(const char* s, size_t* equals) {
+#if defined(GETOPT_SSE2)
+  const __m128i nul = _mm_setzero_si128();
+  const __m128i eq = _mm_set1_epi8('=');
+  unsigned skip = (unsigned)((uintptr_t)s & 15);
+  const char* block = s - skip;
+  size_t found = (size_t)-1;
+
+  for (;; block += 16, skip = 0) {
+    __m128i bytes = _mm_load_si128((const __m128i*)block);
+    unsigned nuls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nul));
+    unsigned eqs = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, eq));
+
+    /* Ignore the bytes before s, and any '=' after the end. */
+    nuls = (nuls >> skip) << skip;
+    eqs = (eqs >> skip) << skip;
+    if (nuls != 0)
+      eqs &= (nuls & (0u - nuls)) - 1;
+
+    if (found == (size_t)-1 && eqs != 0)
+      found = (size_t)(block - s) + lowest_bit(eqs);
+    if (nuls != 0) {
+      size_t length = (size_t)(block - s) + lowest_bit(nuls);
+      *equals = found == (size_t)-1 ? length : found;
+      return length;
+    }
+  }
+#else
+  const char* p = s;
+
+  while (*p != '\0' && *p != '=')
+    ++p;
+  *equals = (size_t)(p - s);
+  while (*p != '\0')
+    ++p;
+  return (size_t)(p - s);
+#endif
+}
+
+/* Passes an erroneous option to the diagnose callback, if there is one,
+   along with the keywords it could have taken or the option it may have
+   been meant as. */
+static void report_detailed(const char** argv, int index, int error,
+  int longopt, const char* option, size_t length, int num_matches,
+  const char* const* keywords, const char* suggestion,
+  const struct getopt_state* state) {
+  struct getopt_diagnostic diagnostic;
+
+  GETOPT_COUNT(instrument(state, GETOPT_TRACE_ERROR, state->index_base + index,
+    (unsigned long)error));
+  if (state->diagnose == NULL)
     return;
-  const char *tmp = argv[0];
-  memmove(argv, argv + 1, (argc - 1) * sizeof(char *));
-  argv[argc - 1] = tmp;
+
+  diagnostic.error = error;
+  diagnostic.index = state->index_base + index;
+  diagnostic.longopt = longopt;
+  diagnostic.option.data = option;
+  diagnostic.option.length = length;
+  diagnostic.num_matches = num_matches;
+  diagnostic.progname = argv[0];
+  diagnostic.value = state->optvalue;
+  diagnostic.keywords = keywords;
+  diagnostic.suggestion = suggestion;
+  state->diagnose(state->diagnose_context, &diagnostic);
 }
 
-/* Implemented based on [1] and [2] for optional arguments.
-   optopt is handled FreeBSD-style, per [3].
-   Other GNU and FreeBSD extensions are purely accidental.
+static void report(const char** argv, int index, int error, int longopt,
+  const char* option, size_t length, int num_matches,
+  const struct getopt_state* state) {
+  report_detailed(argv, index, error, longopt, option, length, num_matches,
+    NULL, NULL, state);
+}
 
-[1] http://pubs.opengroup.org/onlinepubs/000095399/functions/getopt.html
-[2] http://www.kernel.org/doc/man-pages/online/pages/man3/getopt.3.html
-[3] http://www.freebsd.org/cgi/man.cgi?query=getopt&sektion=3&manpath=FreeBSD+9.0-RELEASE
-*/
-int getopt(int argc, const char** argv, const char* optstring) {
-  int optchar = -1;
-  const char* optdecl = NULL;
-
-  optarg = NULL;
-  opterr = 0;
-  optopt = 0;
-
-  /* Is `optind` reset by userland code? */
-  if (optind <= 1)
-      optind = 1;
-
-  /* Unspecified, but we need it to avoid overrunning the argv bounds. */
-  if (optind >= argc)
-    goto no_more_optchars;
-
-  /* If, when getopt() is called argv[optind] is a null pointer, getopt()
-     shall return -1 without changing optind. */
-  if (argv[optind] == NULL)
-    goto no_more_optchars;
-
-  /* If, when getopt() is called *argv[optind] is not the character '-',
-     permute argv to move non options to the end */
-  if (*argv[optind] != '-') {
-    if (argc - optind <= 1)
-      goto no_more_optchars;
-
-    if (!first)
-      first = argv[optind];
-
-    do {
-      rotate(argv + optind, argc - optind);
-    } while (*argv[optind] != '-' && argv[optind] != first);
-
-    if (argv[optind] == first)
-      goto no_more_optchars;
-  }
-
-  /* If, when getopt() is called argv[optind] points to the string "-",
-     getopt() shall return -1 without changing optind. */
-  if (strcmp(argv[optind], "-") == 0)
-    goto no_more_optchars;
-
-  /* If, when getopt() is called argv[optind] points to the string "--",
-     getopt() shall return -1 after incrementing optind. */
-  if (strcmp(argv[optind], "--") == 0) {
-    ++optind;
-    if (first) {
-      do {
-        rotate(argv + optind, argc - optind);
-      } while (argv[optind] != first);
-    }
-    goto no_more_optchars;
-  }
-
-  if (optcursor == NULL || *optcursor == '\0')
-    optcursor = argv[optind] + 1;
-
-  optchar = *optcursor;
-
-  /* FreeBSD: The variable optopt saves the last known option character
-     returned by getopt(). */
-  optopt = optchar;
-
-  /* The getopt() function shall return the next option character (if one is
-     found) from argv that matches a character in optstring, if there is
-     one that matches. */
-  optdecl = strchr(optstring, optchar);
-  if (optdecl) {
-    /* [I]f a character is followed by a colon, the option takes an
-       argument. */
-    if (optdecl[1] == ':') {
-      optarg = ++optcursor;
-      if (*optarg == '\0') {
-        /* GNU extension: Two colons mean an option takes an
-           optional arg; if there is text in the current argv-element
-           (i.e., in the same word as the option name itself, for example,
-           "-oarg"), then it is returned in optarg, otherwise optarg is set
-           to zero. */
-        if (optdecl[2] != ':') {
-          /* If the option was the last character in the string pointed to by
-             an element of argv, then optarg shall contain the next element
-             of argv, and optind shall be incremented by 2. If the resulting
-             value of optind is greater than argc, this indicates a missing
-             option-argument, and getopt() shall return an error indication.
-
-             Otherwise, optarg shall point to the string following the
-             option character in that element of argv, and optind shall be
-             incremented by 1.
-          */
-          if (++optind < argc) {
-            optarg = argv[optind];
-          } else {
-            /* If it detects a missing option-argument, it shall return the
-               colon character ( ':' ) if the first character of optstring
-               was a colon, or a question-mark character ( '?' ) otherwise.
-            */
-            optarg = NULL;
-            if (opterr)
-              fprintf(stderr, "%s: option requires an argument -- '%c'\n", argv[0], optchar);
-            optchar = (optstring[0] == ':') ? ':' : '?';
-          }
-        } else {
-          optarg = NULL;
-        }
-      }
-      optcursor = NULL;
+#if !defined(GETOPT_NO_STDIO)
+void getopt_diagnose_stderr(void* context,
+  const struct getopt_diagnostic* diagnostic) {
+  const char* progname = diagnostic->progname;
+  int length = (int)diagnostic->option.length;
+  const char* option = diagnostic->option.data;
+
+  (void)context;
+  switch (diagnostic->error) {
+  case GETOPT_ERROR_UNKNOWN_OPTION:
+    if (diagnostic->longopt) {
+      fprintf(stderr, "%s: unrecognized option '--%.*s'\n", progname, length,
+        option);
+      if (diagnostic->suggestion != NULL)
+        fprintf(stderr, "Did you mean '--%s'?\n", diagnostic->suggestion);
+    } else
+      fprintf(stderr, "%s: invalid option -- '%.*s'\n", progname, length,
+        option);
+    break;
+  case GETOPT_ERROR_AMBIGUOUS_OPTION:
+    fprintf(stderr, "%s: option '--%.*s' is ambiguous\n", progname, length,
+      option);
+    break;
+  case GETOPT_ERROR_MISSING_ARGUMENT:
+    if (diagnostic->longopt)
+      fprintf(stderr, "%s: option '--%.*s' requires an argument\n", progname,
+        length, option);
+    else
+      fprintf(stderr, "%s: option requires an argument -- '%.*s'\n",
+        progname, length, option);
+    break;
+  case GETOPT_ERROR_UNEXPECTED_ARGUMENT:
+    fprintf(stderr, "%s: option '--%.*s' doesn't allow an argument\n",
+      progname, length, option);
+    break;
+  case GETOPT_ERROR_UNKNOWN_COMMAND:
+    fprintf(stderr, "%s: '%.*s' is not a command\n", progname, length,
+      option);
+    break;
+  case GETOPT_ERROR_INVALID_VALUE:
+  case GETOPT_ERROR_OUT_OF_RANGE:
+    fprintf(stderr, "%s: %s '%.*s' for '%s%.*s'\n", progname,
+      diagnostic->error == GETOPT_ERROR_INVALID_VALUE ? "invalid argument" :
+      "out of range argument", (int)diagnostic->value.length,
+      diagnostic->value.data, diagnostic->longopt ? "--" : "-", length,
+      option);
+    if (diagnostic->keywords != NULL && diagnostic->keywords[0] != NULL) {
+      const char* const* keyword = diagnostic->keywords;
+      fprintf(stderr, "Valid arguments are: '%s'", *keyword);
+      while (*++keyword != NULL)
+        fprintf(stderr, ", '%s'", *keyword);
+      fputc('\n', stderr);
     }
-  } else {
-    if (opterr)
-      fprintf(stderr,"%s: invalid option -- '%c'\n", argv[0], optchar);
-    /* If getopt() encounters an option character that is not contained in
-       optstring, it shall return the question-mark ( '?' ) character. */
-    optchar = '?';
+    break;
   }
+}
+#endif
 
-  if (optcursor == NULL || *++optcursor == '\0')
-    ++optind;
+/* Sets optarg, with its length, or clears it if arg is NULL. */
+static void set_optarg(struct getopt_state* state, const char* arg,
+  size_t length) {
+  state->optarg = arg;
+  state->optvalue.data = arg;
+  state->optvalue.length = length;
+}
 
-  return optchar;
+static void set_optname(struct getopt_state* state, const char* name,
+  size_t length) {
+  state->optname.data = name;
+  state->optname.length = length;
+}
 
-no_more_optchars:
-  optcursor = NULL;
-  first = NULL;
-  return -1;
+/* Clears what the last call returned, before looking for the next option. */
+static void clear_option(struct getopt_state* state) {
+  set_optarg(state, NULL, 0);
+  set_optname(state, NULL, 0);
+  state->opterr = 0;
+  state->optopt = 0;
 }
 
-/* Implementation based on [1].
+/* Accumulates the decimal digits at *p into *value, advancing *p. Returns
+   the number of digits, or -1 if the value overflows. */
+static int parse_digits(const char** p, const char* end,
+  unsigned long long* value) {
+  const char* begin = *p;
+  unsigned digit = 0;
 
-[1] http://www.kernel.org/doc/man-pages/online/pages/man3/getopt.3.html
-*/
-int getopt_long(int argc, const char** argv, const char* optstring,
-  const struct option* longopts, int* longindex) {
-  const struct option* o = longopts;
-  const struct option* match = NULL;
-  int num_matches = 0;
-  size_t argument_name_length = 0;
-  size_t option_length = 0;
-  const char* current_argument = NULL;
-  int retval = -1;
+  for (; *p < end && (digit = (unsigned)(**p - '0')) <= 9; ++*p) {
+    if (*value > (ULLONG_MAX - digit) / 10)
+      return -1;
+    *value = *value * 10 + digit;
+  }
+  return (int)(*p - begin);
+}
+
+static int parse_int(const char* s, const char* end, long long* value) {
+  unsigned long long magnitude = 0;
+  unsigned long long limit = LLONG_MAX;
+  int negative = 0;
+
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+  if (negative)
+    limit = (unsigned long long)LLONG_MAX + 1;
+
+  switch (parse_digits(&s, end, &magnitude)) {
+  case -1:
+    return GETOPT_ERROR_OUT_OF_RANGE;
+  case 0:
+    return GETOPT_ERROR_INVALID_VALUE;
+  }
+  if (s != end)
+    return GETOPT_ERROR_INVALID_VALUE;
+  if (magnitude > limit)
+    return GETOPT_ERROR_OUT_OF_RANGE;
+
+  *value = negative ? (long long)(0 - magnitude) : (long long)magnitude;
+  return 0;
+}
+
+/* strtod() in the C locale, so that '.' is the decimal point whatever
+   LC_NUMERIC says. The locale is only switched for the calling thread:
+   localeconv() and setlocale() would race with other threads parsing. */
+static int strtod_c(const char* s, const char* end, double* value) {
+  char* parsed = NULL;
+#if defined(_WIN32)
+  _locale_t c = _create_locale(LC_NUMERIC, "C");
+
+  /* Reported as a bad value; there is no error for running out. */
+  if (c == NULL)
+    return GETOPT_ERROR_INVALID_VALUE;
+  *value = _strtod_l(s, &parsed, c);
+  _free_locale(c);
+#elif defined(LC_NUMERIC_MASK)
+  locale_t c = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+  locale_t previous = (locale_t)0;
+
+  if (c == (locale_t)0)
+    return GETOPT_ERROR_INVALID_VALUE;
+  previous = uselocale(c);
+  *value = strtod(s, &parsed);
+  uselocale(previous);
+  freelocale(c);
+#else
+  /* Without per-thread locales, this holds as long as the program leaves
+     LC_NUMERIC alone. */
+  *value = strtod(s, &parsed);
+#endif
+
+  if (parsed != end)
+    return GETOPT_ERROR_INVALID_VALUE;
+  if (*value == HUGE_VAL || *value == -HUGE_VAL)
+    return GETOPT_ERROR_OUT_OF_RANGE;
+  return 0;
+}
+
+/* Decimal mantissas of up to 19 digits that fit in a double exactly are
+   scaled by an exact power of ten, which rounds correctly (Clinger's fast
+   path). Anything else goes to strtod_c(), and relies on the argument
+   being NUL-terminated, as all of argv is. */
+static int parse_double(const char* s, const char* end, double* value) {
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* begin = s;
+  const char* p = s;
+  unsigned long long mantissa = 0;
+  unsigned long long exponent = 0;
+  int digits = 0;
+  int fraction = 0;
+  int exact = 1;
+  int negative = 0;
+  long scale = 0;
+
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+
+  for (; p < end && (*p >= '0' && *p <= '9'); ++p, ++digits) {
+    if (mantissa >= 1000000000000000000ULL)
+      exact = 0;
+    else
+      mantissa = mantissa * 10 + (unsigned)(*p - '0');
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && (*p >= '0' && *p <= '9'); ++p, ++fraction) {
+      if (mantissa >= 1000000000000000000ULL)
+        exact = 0;
+      else
+        mantissa = mantissa * 10 + (unsigned)(*p - '0');
+    }
+  }
+  if (digits + fraction == 0)
+    return GETOPT_ERROR_INVALID_VALUE;
 
-  optarg = NULL;
-  opterr = 0;
-  optopt = 0;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int exponent_negative = 0;
 
-  /* Is `optind` reset by userland code? */
-  if (optind <= 1)
-      optind = 1;
+    ++p;
+    if (p < end && (*p == '-' || *p == '+'))
+      exponent_negative = *p++ == '-';
+    if (parse_digits(&p, end, &exponent) <= 0)
+      exact = 0;
+    else if (exponent > 400)
+      exact = 0;
+    scale = exponent_negative ? -(long)exponent : (long)exponent;
+  }
+  if (p != end)
+    return GETOPT_ERROR_INVALID_VALUE;
+
+  scale -= fraction;
+  if (exact && mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22) {
+    *value = scale < 0 ? (double)mantissa / powers[-scale] :
+      (double)mantissa * powers[scale];
+    if (negative)
+      *value = -*value;
+    return 0;
+  }
+
+  return strtod_c(begin, end, value);
+}
+
+static int parse_size(const char* s, const char* end,
+  unsigned long long* value) {
+  unsigned long long size = 0;
+  int shift = 0;
+
+  switch (parse_digits(&s, end, &size)) {
+  case -1:
+    return GETOPT_ERROR_OUT_OF_RANGE;
+  case 0:
+    return GETOPT_ERROR_INVALID_VALUE;
+  }
+
+  if (s + 1 == end) {
+    switch (*s++) {
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    case 't': case 'T': shift = 40; break;
+    default: return GETOPT_ERROR_INVALID_VALUE;
+    }
+  }
+  if (s != end)
+    return GETOPT_ERROR_INVALID_VALUE;
+  if (size > ULLONG_MAX >> shift)
+    return GETOPT_ERROR_OUT_OF_RANGE;
+
+  *value = size << shift;
+  return 0;
+}
+
+/* Returns the nanoseconds in one of the unit, or 0 if it is not one. */
+static long long duration_unit(const char* s, const char* end) {
+  size_t length = (size_t)(end - s);
+
+  if (length == 0 || (length == 1 && *s == 's'))
+    return 1000000000LL;
+  if (length == 1 && *s == 'm')
+    return 60000000000LL;
+  if (length == 1 && *s == 'h')
+    return 3600000000000LL;
+  if (length == 2 && s[1] == 's') {
+    switch (*s) {
+    case 'n': return 1;
+    case 'u': return 1000;
+    case 'm': return 1000000;
+    }
+  }
+  return 0;
+}
+
+static int parse_duration(const char* s, const char* end, long long* value) {
+  unsigned long long whole = 0;
+  long long unit = 0;
+  long long place = 0;
+  long long total = 0;
+  const char* fraction = NULL;
+  const char* p = s;
+  int digits = 0;
+
+  digits = parse_digits(&p, end, &whole);
+  if (digits < 0)
+    return GETOPT_ERROR_OUT_OF_RANGE;
+  if (p < end && *p == '.') {
+    fraction = ++p;
+    while (p < end && *p >= '0' && *p <= '9')
+      ++p;
+    digits += (int)(p - fraction);
+  }
+  if (digits == 0)
+    return GETOPT_ERROR_INVALID_VALUE;
+
+  unit = duration_unit(p, end);
+  if (unit == 0)
+    return GETOPT_ERROR_INVALID_VALUE;
+  if (whole > (unsigned long long)(LLONG_MAX / unit))
+    return GETOPT_ERROR_OUT_OF_RANGE;
+
+  /* Digits finer than a nanosecond are dropped. */
+  total = (long long)whole * unit;
+  for (place = unit / 10; fraction != NULL && fraction < end &&
+       *fraction >= '0' && *fraction <= '9' && place > 0; place /= 10) {
+    if (total > LLONG_MAX - (*fraction - '0') * place)
+      return GETOPT_ERROR_OUT_OF_RANGE;
+    total += (*fraction++ - '0') * place;
+  }
+
+  *value = total;
+  return 0;
+}
+
+/* Keywords are compiled into a minimal perfect hash, "hash and displace"
+   style: the hash of a keyword picks a bucket, and the displacement found
+   for the bucket when compiling moves all of its keywords to free slots.
+   There are as many slots as keywords, and a lookup costs one hash and
+   one comparison with the keyword in the slot. */
+struct getopt_keyword_table {
+  struct getopt_keywords keywords;
+  unsigned num_names;
+  unsigned num_buckets;
+  unsigned seed;
+  unsigned* displacements;    /* for each bucket */
+  int* slots;                 /* index in names */
+};
+
+/* FNV-1a, from a seeded offset basis. The low half picks the bucket, and
+   the high half the slot. */
+static unsigned long long hash_keyword(const char* s, size_t length,
+  unsigned seed) {
+  unsigned long long h = 14695981039346656037ULL ^ seed;
+  size_t i = 0;
+
+  for (i = 0; i < length; ++i)
+    h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+  return h;
+}
+
+static unsigned keyword_slot(unsigned long long h, unsigned displacement,
+  unsigned num_slots) {
+  /* The finalizer of MurmurHash3. */
+  unsigned x = (unsigned)(h >> 32) + displacement * 0x9e3779b9u;
+  x = (x ^ (x >> 16)) * 0x85ebca6bu;
+  x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+  return (x ^ (x >> 16)) % num_slots;
+}
+
+static int lookup_keyword(const void* context, const char* s,
+  size_t length) {
+  const struct getopt_keyword_table* table =
+    (const struct getopt_keyword_table*)context;
+  unsigned long long h = 0;
+  int index = 0;
 
-  if (optind >= argc)
+  if (table->num_names == 0)
     return -1;
 
-  /* If, when getopt() is called argv[optind] is a null pointer, getopt_long()
-  shall return -1 without changing optind. */
-  if (argv[optind] == NULL)
-    goto no_more_optchars;
-
-  /* If, when getopt_long() is called *argv[optind] is not the character '-',
-  permute argv to move non options to the end */
-  if (*argv[optind] != '-') {
-    if (argc - optind <= 1)
-      goto no_more_optchars;
-
-    if (!first)
-      first = argv[optind];
-
-    do {
-      rotate(argv + optind, argc - optind);
-    } while (*argv[optind] != '-' && argv[optind] != first);
-
-    if (argv[optind] == first)
-      goto no_more_optchars;
-  }
-
-  if (strlen(argv[optind]) < 3 || strncmp(argv[optind], "--", 2) != 0)
-    return getopt(argc, argv, optstring);
-
-  /* It's an option; starts with -- and is longer than two chars. */
-  current_argument = argv[optind] + 2;
-  argument_name_length = strcspn(current_argument, "=");
-  for (; o->name; ++o) {
-    /* Check for exact match first. */
-    option_length = strlen(o->name);
-    if (option_length == argument_name_length &&
-        strncmp(o->name, current_argument, option_length) == 0) {
-      match = o;
-      num_matches = 1;
-      break;
+  h = hash_keyword(s, length, table->seed);
+  index = table->slots[keyword_slot(h,
+    table->displacements[(unsigned)h % table->num_buckets],
+    table->num_names)];
+  if (strncmp(table->keywords.names[index], s, length) == 0 &&
+      table->keywords.names[index][length] == '\0')
+    return index;
+  return -1;
+}
+
+struct getopt_bucket {
+  unsigned size;
+  unsigned bucket;
+};
+
+/* Larger buckets are harder to place, and go first. */
+static int compare_buckets(const void* lhs, const void* rhs) {
+  const struct getopt_bucket* a = (const struct getopt_bucket*)lhs;
+  const struct getopt_bucket* b = (const struct getopt_bucket*)rhs;
+
+  if (a->size != b->size)
+    return a->size > b->size ? -1 : 1;
+  return (a->bucket > b->bucket) - (a->bucket < b->bucket);
+}
+
+/* Places every bucket with the table's seed, using `members` for the
+   keywords of each bucket, sorted by bucket, and `order` for the buckets
+   by size. Returns 1 on success, 0 if the seed does not work out, or -1
+   if names has duplicates. */
+static int place_keywords(struct getopt_keyword_table* table,
+  unsigned long long* hashes, unsigned* members, unsigned* first,
+  struct getopt_bucket* order) {
+  const char* const* names = table->keywords.names;
+  unsigned n = table->num_names;
+  unsigned i = 0;
+  unsigned j = 0;
+  unsigned k = 0;
+  unsigned b = 0;
+  unsigned d = 0;
+  unsigned slot = 0;
+
+  for (i = 0; i < n; ++i)
+    hashes[i] = hash_keyword(names[i], strlen(names[i]), table->seed);
+
+  /* Counting sort of the keywords by bucket. */
+  memset(first, 0, (table->num_buckets + 1) * sizeof(unsigned));
+  for (i = 0; i < n; ++i)
+    ++first[(unsigned)hashes[i] % table->num_buckets + 1];
+  for (b = 0; b < table->num_buckets; ++b) {
+    order[b].size = first[b + 1];
+    order[b].bucket = b;
+    first[b + 1] += first[b];
+  }
+  for (i = 0; i < n; ++i) {
+    b = (unsigned)hashes[i] % table->num_buckets;
+    members[first[b] + --order[b].size] = i;
+  }
+  for (b = 0; b < table->num_buckets; ++b)
+    order[b].size = first[b + 1] - first[b];
+  qsort(order, table->num_buckets, sizeof(struct getopt_bucket),
+    compare_buckets);
+
+  /* Keywords whose whole hashes collide can never be told apart. */
+  for (b = 0; b < table->num_buckets; ++b) {
+    for (i = first[b]; i < first[b + 1]; ++i) {
+      for (j = i + 1; j < first[b + 1]; ++j) {
+        if (hashes[members[i]] != hashes[members[j]])
+          continue;
+        if (strcmp(names[members[i]], names[members[j]]) == 0)
+          return -1;
+        return 0;
+      }
     }
+  }
 
-    /* If not exact, count the number of abbreviated matches. */
-    if (strncmp(o->name, current_argument, argument_name_length) == 0) {
-      match = o;
-      ++num_matches;
-      if (strlen(o->name) == argument_name_length) {
-        /* found match is exactly the one which we are looking for */
-        num_matches = 1;
-        break;
+  for (i = 0; i < n; ++i)
+    table->slots[i] = -1;
+  for (k = 0; k < table->num_buckets && order[k].size > 0; ++k) {
+    b = order[k].bucket;
+    for (d = 0;; ++d) {
+      if (d > 64 * n + 1024)
+        return 0;
+
+      /* Claim the slots of the bucket, backing out on a collision. */
+      for (i = first[b]; i < first[b + 1]; ++i) {
+        slot = keyword_slot(hashes[members[i]], d, n);
+        if (table->slots[slot] >= 0)
+          break;
+        table->slots[slot] = (int)members[i];
       }
+      if (i == first[b + 1])
+        break;
+      for (j = first[b]; j < i; ++j)
+        table->slots[keyword_slot(hashes[members[j]], d, n)] = -1;
+    }
+    table->displacements[b] = d;
+  }
+  return 1;
+}
+
+struct getopt_keywords* getopt_keywords_compile(const char* const* names) {
+  struct getopt_keyword_table* table = NULL;
+  unsigned long long* hashes = NULL;
+  unsigned* members = NULL;
+  unsigned* first = NULL;
+  struct getopt_bucket* order = NULL;
+  unsigned n = 0;
+  unsigned num_buckets = 0;
+  int placed = 0;
+
+  while (names[n] != NULL)
+    ++n;
+  num_buckets = n / 4 + 1;
+
+  table = (struct getopt_keyword_table*)GETOPT_MALLOC(
+    sizeof(struct getopt_keyword_table) + num_buckets * sizeof(unsigned) +
+    n * sizeof(int));
+  hashes = (unsigned long long*)GETOPT_MALLOC(
+    n * sizeof(unsigned long long) + (n + num_buckets + 1) * sizeof(unsigned) +
+    num_buckets * sizeof(struct getopt_bucket));
+  if (table == NULL || hashes == NULL) {
+    GETOPT_FREE(table);
+    GETOPT_FREE(hashes);
+    return NULL;
+  }
+  order = (struct getopt_bucket*)(hashes + n);
+  members = (unsigned*)(order + num_buckets);
+  first = members + n;
+
+  table->keywords.names = names;
+  table->keywords.lookup = lookup_keyword;
+  table->keywords.context = table;
+  table->num_names = n;
+  table->num_buckets = num_buckets;
+  table->displacements = (unsigned*)(table + 1);
+  table->slots = (int*)(table->displacements + num_buckets);
+
+  /* A seed works out with high probability; others are tried in turn. */
+  for (table->seed = 0; table->seed < 64 && placed == 0; ++table->seed) {
+    placed = place_keywords(table, hashes, members, first, order);
+    if (placed == 1)
+      break;
+  }
+
+  GETOPT_FREE(hashes);
+  if (placed != 1) {
+    GETOPT_FREE(table);
+    return NULL;
+  }
+  return &table->keywords;
+}
+
+void getopt_keywords_free(struct getopt_keywords* keywords) {
+  GETOPT_FREE(keywords);
+}
+
+/* Converts the option-argument of option `id`, if it is listed in
+   state->values, into its storage. Returns id, or '?' if the argument
+   does not convert. */
+static int convert_value(const char** argv, int index, int longopt, int id,
+  struct getopt_state* state) {
+  const struct getopt_value* value = state->values;
+  const char* s = state->optvalue.data;
+  const char* end = s + state->optvalue.length;
+  long long integer = 0;
+  int error = 0;
+
+  if (value == NULL || s == NULL)
+    return id;
+  while (value->type != 0 && value->id != id)
+    ++value;
+
+  switch (value->type) {
+  case 0:
+    return id;
+  case GETOPT_TYPE_INT:
+    error = parse_int(s, end, &integer);
+    if (error == 0 && (value->min != 0 || value->max != 0) &&
+        (integer < value->min || integer > value->max))
+      error = GETOPT_ERROR_OUT_OF_RANGE;
+    if (error == 0)
+      *(long long*)value->storage = integer;
+    break;
+  case GETOPT_TYPE_DOUBLE:
+    error = parse_double(s, end, (double*)value->storage);
+    break;
+  case GETOPT_TYPE_SIZE:
+    error = parse_size(s, end, (unsigned long long*)value->storage);
+    break;
+  case GETOPT_TYPE_DURATION:
+    error = parse_duration(s, end, (long long*)value->storage);
+    break;
+  case GETOPT_TYPE_ENUM:
+    integer = value->keywords->lookup(value->keywords->context, s,
+      state->optvalue.length);
+    if (integer < 0)
+      error = GETOPT_ERROR_INVALID_VALUE;
+    else
+      *(int*)value->storage = (int)integer;
+    break;
+  }
+
+  if (error == 0)
+    return id;
+  report_detailed(argv, index, error, longopt, state->optname.data,
+    state->optname.length, 0, value->type == GETOPT_TYPE_ENUM ?
+    value->keywords->names : NULL, NULL, state);
+  state->optopt = id;
+  return '?';
+}
+
+/* The parser itself is in getopt_core.inc, which getopt_basic.hpp
+   includes again for the other character types. */
+#define GETOPT_CHAR char
+#define GETOPT_STATE struct getopt_state
+#define GETOPT_OPTION struct option
+#define GETOPT_CORE static
+#define GETOPT_LENGTH strlen
+
+static int resolve_long(const struct getopt_resolver* resolver,
+  const char* name, size_t length, int* num_matches,
+  unsigned long* comparisons);
+static void report_unmatched(const char** argv, int index,
+  const struct option* longopts, const char* option, size_t length,
+  int num_matches, const struct getopt_state* state);
+
+#include "getopt_core.inc"
+
+int getopt_r(int argc, const char** argv, const char* optstring,
+  struct getopt_state* state) {
+  return parse_short(argc, argv, optstring, NULL, state);
+}
+
+/* Orders options by name, and options with the same name by position. */
+static int compare_options(const void* lhs, const void* rhs) {
+  const struct option* a = *(const struct option* const*)lhs;
+  const struct option* b = *(const struct option* const*)rhs;
+  int order = strcmp(a->name, b->name);
+
+  if (order != 0)
+    return order;
+  return (a > b) - (a < b);
+}
+
+/* Fills in `node` from the sorted options in [begin, end), which share
+   their first `depth` characters, allocating its children from *next. */
+static void build_node(struct getopt_spec* spec, const struct option** sorted,
+  int begin, int end, size_t depth, int node, int* next) {
+  struct getopt_node* n = &spec->nodes[node];
+  int child = 0;
+  int i = 0;
+  int j = 0;
+
+  n->exact = -1;
+  n->count = end - begin;
+  n->first = begin < end ?
+    (int)(sorted[begin] - spec->resolver.longopts) : -1;
+  n->begin = begin;
+  n->num_children = 0;
+
+  /* Names that end here sort first, the earliest option first. */
+  if (begin < end && sorted[begin]->name[depth] == '\0') {
+    n->exact = n->first;
+    while (begin < end && sorted[begin]->name[depth] == '\0')
+      ++begin;
+  }
+
+  for (i = begin; i < end; i = j) {
+    for (j = i; j < end && sorted[j]->name[depth] == sorted[i]->name[depth];)
+      ++j;
+    ++n->num_children;
+  }
+
+  n->children = *next;
+  *next += n->num_children;
+
+  for (i = begin, child = n->children; i < end; i = j, ++child) {
+    for (j = i; j < end && sorted[j]->name[depth] == sorted[i]->name[depth];)
+      ++j;
+    spec->nodes[child].c = (unsigned char)sorted[i]->name[depth];
+    build_node(spec, sorted, i, j, depth + 1, child, next);
+  }
+}
+
+static int lookup_spec(const void* context, const char* name, size_t length,
+  int* num_matches) {
+  return getopt_spec_lookup((const struct getopt_spec*)context, name, length,
+    num_matches);
+}
+
+struct getopt_spec* getopt_compile(const char* optstring,
+  const struct option* longopts) {
+  struct getopt_spec* spec = NULL;
+  const struct option** sorted = NULL;
+  const struct option* o = NULL;
+  const char* c = NULL;
+  size_t num_nodes = 1;
+  int num_options = 0;
+  int next = 1;
+
+  if (longopts) {
+    for (o = longopts; o->name; ++o) {
+      num_nodes += strlen(o->name);
+      ++num_options;
+    }
+  }
+
+  spec = (struct getopt_spec*)GETOPT_MALLOC(sizeof(struct getopt_spec) +
+    num_nodes * sizeof(struct getopt_node) + num_options * sizeof(int));
+  if (spec == NULL)
+    return NULL;
+
+  spec->resolver.optstring = optstring ? optstring : "";
+  spec->resolver.longopts = longopts;
+  spec->resolver.shortopts = spec->shortopts;
+  spec->resolver.lookup = lookup_spec;
+  spec->resolver.context = spec;
+  spec->nodes = NULL;
+  spec->sorted = NULL;
+
+  /* Record each character as declared by its first occurrence, which is
+     what strchr() would find. */
+  memset(spec->shortopts, 0, sizeof(spec->shortopts));
+  c = spec->resolver.optstring;
+  if (*c == '+' || *c == '-')
+    ++c;
+  for (; *c; ++c) {
+    if (spec->shortopts[(unsigned char)*c] == 0)
+      spec->shortopts[(unsigned char)*c] = (unsigned char)classify(c, *c);
+  }
+
+  if (longopts) {
+    sorted = (const struct option**)GETOPT_MALLOC(
+      (num_options + 1) * sizeof(const struct option*));
+    if (sorted == NULL) {
+      GETOPT_FREE(spec);
+      return NULL;
+    }
+
+    for (num_options = 0, o = longopts; o->name; ++o)
+      sorted[num_options++] = o;
+    qsort(sorted, num_options, sizeof(const struct option*), compare_options);
+
+    spec->nodes = (struct getopt_node*)(spec + 1);
+    build_node(spec, sorted, 0, num_options, 0, 0, &next);
+    spec->sorted = (int*)(spec->nodes + num_nodes);
+    for (next = 0; next < num_options; ++next)
+      spec->sorted[next] = (int)(sorted[next] - longopts);
+    GETOPT_FREE(sorted);
+  }
+
+  return spec;
+}
+
+void getopt_spec_free(struct getopt_spec* spec) {
+  GETOPT_FREE(spec);
+}
+
+int getopt_spec_short(const struct getopt_spec* spec, int optchar) {
+  return spec->shortopts[(unsigned char)optchar];
+}
+
+/* Returns the node for the first `length` characters of name, or NULL if
+   no option starts with them. */
+static const struct getopt_node* find_node(const struct getopt_spec* spec,
+  const char* name, size_t length, unsigned long* comparisons) {
+  const struct getopt_node* node = spec->nodes;
+  size_t i = 0;
+
+  /* Only counted when built with GETOPT_INSTRUMENT. */
+  (void)comparisons;
+  if (node == NULL)
+    return NULL;
+
+  for (i = 0; i < length; ++i) {
+    unsigned char c = (unsigned char)name[i];
+    const struct getopt_node* lo = spec->nodes + node->children;
+    const struct getopt_node* hi = lo + node->num_children;
+
+    while (lo < hi) {
+      const struct getopt_node* mid = lo + (hi - lo) / 2;
+      GETOPT_COUNT(if (comparisons) ++*comparisons);
+      if (mid->c < c)
+        lo = mid + 1;
+      else
+        hi = mid;
     }
+
+    if (lo == spec->nodes + node->children + node->num_children || lo->c != c)
+      return NULL;
+    node = lo;
+  }
+  return node;
+}
+
+/* getopt_spec_lookup(), counting the trie nodes visited in *comparisons
+   if it is not NULL. */
+static int find_in_trie(const struct getopt_spec* spec, const char* name,
+  size_t length, int* num_matches, unsigned long* comparisons) {
+  const struct getopt_node* node = find_node(spec, name, length,
+    comparisons);
+
+  *num_matches = 0;
+  if (node == NULL)
+    return -1;
+
+  /* Exact matches win over abbreviations of longer names. */
+  if (node->exact >= 0) {
+    *num_matches = 1;
+    return node->exact;
   }
 
-  if (num_matches == 1) {
-    /* If longindex is not NULL, it points to a variable which is set to the
-       index of the long option relative to longopts. */
-    if (longindex)
-      *longindex = (int)(match - longopts);
+  *num_matches = node->count;
+  return node->count == 1 ? node->first : -1;
+}
 
-    /* If flag is NULL, then getopt_long() shall return val.
-       Otherwise, getopt_long() returns 0, and flag shall point to a variable
-       which shall be set to val if the option is found, but left unchanged if
-       the option is not found. */
-    if (match->flag)
-      *(match->flag) = match->val;
+int getopt_spec_lookup(const struct getopt_spec* spec, const char* name,
+  size_t length, int* num_matches) {
+  return find_in_trie(spec, name, length, num_matches, NULL);
+}
+
+int getopt_spec_complete(const struct getopt_spec* spec, const char* prefix,
+  size_t length, const int** matches) {
+  const struct getopt_node* node = find_node(spec, prefix, length, NULL);
+
+  if (node == NULL || node->count == 0) {
+    *matches = NULL;
+    return 0;
+  }
+  *matches = spec->sorted + node->begin;
+  return node->count;
+}
+
+/* Resolves a long option name through resolver->lookup(), or for a spec
+   built with GETOPT_INSTRUMENT, through its trie to count the nodes. */
+static int resolve_long(const struct getopt_resolver* resolver,
+  const char* name, size_t length, int* num_matches,
+  unsigned long* comparisons) {
+  (void)comparisons;
+#if defined(GETOPT_INSTRUMENT)
+  if (resolver->lookup == lookup_spec)
+    return find_in_trie((const struct getopt_spec*)resolver->context, name,
+      length, num_matches, comparisons);
+#endif
+  return resolver->lookup(resolver->context, name, length, num_matches);
+}
 
-    retval = match->flag ? 0 : match->val;
+/* Returns the edit distance between the pattern described by peq, of
+   length m, and name, or a number greater than max_distance once the
+   distance is known to exceed it. This is Myers' bit-parallel algorithm,
+   in Hyyro's formulation for the distance between whole strings: bit i of
+   the vertical deltas describes row i + 1 of the dynamic programming
+   matrix, and a column of it is computed per character of name. */
+static int edit_distance(const unsigned long long* peq, size_t m,
+  const char* name, int max_distance) {
+  unsigned long long pv = ~0ULL;
+  unsigned long long mv = 0;
+  unsigned long long high = 1ULL << (m - 1);
+  size_t n = strlen(name);
+  size_t j = 0;
+  int score = (int)m;
 
-    if (match->has_arg != no_argument) {
-      optarg = strchr(argv[optind], '=');
-      if (optarg != NULL)
-        ++optarg;
+  if ((m > n ? m - n : n - m) > (size_t)max_distance)
+    return max_distance + 1;
 
-      if (match->has_arg == required_argument) {
-        /* Only scan the next argv for required arguments. Behavior is not
-           specified, but has been observed with Ubuntu and Mac OSX. */
-        if (optarg == NULL && ++optind < argc) {
-          optarg = argv[optind];
-        }
+  for (j = 0; j < n; ++j) {
+    unsigned long long eq = peq[(unsigned char)name[j]];
+    unsigned long long xv = eq | mv;
+    unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+    unsigned long long ph = mv | ~(xh | pv);
+    unsigned long long mh = pv & xh;
 
-        if (optarg == NULL)
-          retval = ':';
+    if (ph & high)
+      ++score;
+    else if (mh & high)
+      --score;
+
+    /* The distance drops by at most one per remaining character. */
+    if (score - (int)(n - j - 1) > max_distance)
+      return max_distance + 1;
+
+    /* Row 0 of every column is one more than in the previous one. */
+    ph = (ph << 1) | 1;
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+  return score;
+}
+
+int getopt_suggest(const struct option* longopts, const char* name,
+  size_t length, int max_distance, int* indices, int max_indices) {
+  unsigned long long peq[256];
+  int distances[GETOPT_MAX_SUGGESTIONS];
+  const struct option* o = NULL;
+  int count = 0;
+  int distance = 0;
+  int i = 0;
+  size_t k = 0;
+
+  if (length == 0 || length > 64 || max_distance < 0 || max_indices <= 0)
+    return 0;
+  if (max_indices > GETOPT_MAX_SUGGESTIONS)
+    max_indices = GETOPT_MAX_SUGGESTIONS;
+
+  memset(peq, 0, sizeof(peq));
+  for (k = 0; k < length; ++k)
+    peq[(unsigned char)name[k]] |= 1ULL << k;
+
+  for (o = longopts; o->name; ++o) {
+    distance = edit_distance(peq, length, o->name, max_distance);
+    if (distance > max_distance)
+      continue;
+
+    /* Insert in order of distance, after any as close, and once the list
+       is full, look only for closer names. */
+    for (i = count; i > 0 && distances[i - 1] > distance; --i) {
+      if (i < max_indices) {
+        distances[i] = distances[i - 1];
+        indices[i] = indices[i - 1];
       }
-    } else if (strchr(argv[optind], '=')) {
-      /* An argument was provided to a non-argument option.
-         I haven't seen this specified explicitly, but both GNU and BSD-based
-         implementations show this behavior.
-      */
+    }
+    if (i < max_indices) {
+      distances[i] = distance;
+      indices[i] = (int)(o - longopts);
+      if (count < max_indices)
+        ++count;
+    }
+    if (count == max_indices) {
+      max_distance = distances[count - 1] - 1;
+      if (max_distance < 0)
+        break;
+    }
+  }
+  return count;
+}
+
+/* Returns the name of the long option closest to the `length` characters
+   at name, if one is close enough to be a likely misspelling: at most three
+   edits away, and no more than a third of its length. */
+static const char* suggest(const struct option* longopts, const char* name,
+  size_t length) {
+  int max_distance = length < 9 ? (int)(length / 3) : 3;
+  int index = 0;
+
+  if (longopts == NULL || max_distance == 0 ||
+      getopt_suggest(longopts, name, length, max_distance, &index, 1) == 0)
+    return NULL;
+  return longopts[index].name;
+}
+
+/* Reports an unknown or ambiguous long option. Only looks for a suggestion
+   if someone will see it. */
+static void report_unmatched(const char** argv, int index,
+  const struct option* longopts, const char* option, size_t length,
+  int num_matches, const struct getopt_state* state) {
+  report_detailed(argv, index, num_matches == 0 ?
+    GETOPT_ERROR_UNKNOWN_OPTION : GETOPT_ERROR_AMBIGUOUS_OPTION, 1, option,
+    length, num_matches, NULL, num_matches == 0 && state->diagnose != NULL ?
+    suggest(longopts, option, length) : NULL, state);
+}
+
+int getopt_long_r(int argc, const char** argv, const char* optstring,
+  const struct option* longopts, int* longindex, struct getopt_state* state) {
+  return parse_long(argc, argv, optstring, longopts, NULL, longindex, state);
+}
+
+int getopt_resolved_r(int argc, const char** argv,
+  const struct getopt_resolver* resolver, int* longindex,
+  struct getopt_state* state) {
+  if (resolver->longopts == NULL)
+    return parse_short(argc, argv, resolver->optstring, resolver, state);
+
+  return parse_long(argc, argv, resolver->optstring, resolver->longopts,
+    resolver, longindex, state);
+}
+
+int getopt_compiled_r(int argc, const char** argv,
+  const struct getopt_spec* spec, int* longindex, struct getopt_state* state) {
+  return getopt_resolved_r(argc, argv, &spec->resolver, longindex, state);
+}
+
+const struct getopt_resolver* getopt_spec_resolver(
+  const struct getopt_spec* spec) {
+  return &spec->resolver;
+}
+
+static void add_record(struct getopt_result* result, int id, int longindex,
+  int index, const struct getopt_slice* arg) {
+  if (result->num_records < result->max_records) {
+    struct getopt_record* record = &result->records[result->num_records];
+    record->id = id;
+    record->longindex = longindex;
+    record->index = index;
+    record->arg = arg->data;
+    record->arg_length = arg->length;
+  }
+  ++result->num_records;
+}
+
+static void add_operand(struct getopt_result* result, int index) {
+  if (result->num_operands < result->max_operands)
+    result->operands[result->num_operands] = index;
+  ++result->num_operands;
+}
+
+int getopt_parse_resolved(int argc, const char* const* argv,
+  const struct getopt_resolver* resolver, struct getopt_result* result) {
+  /* argv is never written to: operands are collected here, so the parser
+     never gets to permute them. */
+  const char** args = (const char**)argv;
+  struct getopt_state state;
+  int longindex = -1;
+  int index = 1;
+  int id = 0;
+  int flags = 0;
+
+  memset(&state, 0, sizeof(state));
+  state.optind = 1;
+  result->num_records = 0;
+  result->num_operands = 0;
+  skip_ordering(resolver->optstring, &flags);
+
+  while (state.optind < argc && argv[state.optind] != NULL) {
+    index = state.optind;
+    if (*argv[index] != '-') {
+      if (flags & GETOPT_REQUIRE_ORDER)
+        break;
+      add_operand(result, index);
+      ++state.optind;
+      continue;
+    }
+
+    longindex = -1;
+    id = getopt_resolved_r(argc, args, resolver, &longindex, &state);
+    if (id == -1)
+      break;
+    add_record(result, id, longindex, index, &state.optvalue);
+  }
+
+  /* Everything after "--" or "-", or the first operand with a '+'
+     optstring, is an operand. */
+  for (index = state.optind; index < argc && argv[index] != NULL; ++index)
+    add_operand(result, index);
+
+  if (result->num_records > result->max_records ||
+      result->num_operands > result->max_operands)
+    return -1;
+  return 0;
+}
+
+int getopt_parse(int argc, const char* const* argv,
+  const struct getopt_spec* spec, struct getopt_result* result) {
+  return getopt_parse_resolved(argc, argv, &spec->resolver, result);
+}
+
+/* A command, with its subcommands in nodes[first, first + num_commands)
+   sorted by name. */
+struct getopt_command_node {
+  const struct getopt_command* command;
+  struct getopt_spec* spec;
+  int first;
+  int num_commands;
+};
+
+/* The nodes are laid out breadth-first, the root first. */
+struct getopt_command_tree {
+  int num_nodes;
+  struct getopt_command_node* nodes;
+};
+
+static int count_commands(const struct getopt_command* command) {
+  const struct getopt_command* c = NULL;
+  int count = 1;
+
+  for (c = command->commands; c != NULL && c->name != NULL; ++c)
+    count += count_commands(c);
+  return count;
+}
+
+static int compare_commands(const void* lhs, const void* rhs) {
+  const struct getopt_command_node* a =
+    (const struct getopt_command_node*)lhs;
+  const struct getopt_command_node* b =
+    (const struct getopt_command_node*)rhs;
+
+  return strcmp(a->command->name, b->command->name);
+}
+
+struct getopt_command_tree* getopt_command_compile(
+  const struct getopt_command* root) {
+  struct getopt_command_tree* tree = NULL;
+  struct getopt_command_node* node = NULL;
+  const struct getopt_command* c = NULL;
+  int num_nodes = count_commands(root);
+  int next = 1;
+  int i = 0;
+
+  tree = (struct getopt_command_tree*)GETOPT_MALLOC(
+    sizeof(struct getopt_command_tree) +
+    num_nodes * sizeof(struct getopt_command_node));
+  if (tree == NULL)
+    return NULL;
+
+  tree->num_nodes = num_nodes;
+  tree->nodes = (struct getopt_command_node*)(tree + 1);
+  memset(tree->nodes, 0, num_nodes * sizeof(struct getopt_command_node));
+  tree->nodes[0].command = root;
+
+  for (i = 0; i < num_nodes; ++i) {
+    node = &tree->nodes[i];
+    node->spec = getopt_compile(node->command->optstring,
+      node->command->longopts);
+    if (node->spec == NULL) {
+      getopt_command_tree_free(tree);
+      return NULL;
+    }
+
+    node->first = next;
+    for (c = node->command->commands; c != NULL && c->name != NULL; ++c)
+      tree->nodes[next++].command = c;
+    node->num_commands = next - node->first;
+    qsort(tree->nodes + node->first, node->num_commands,
+      sizeof(struct getopt_command_node), compare_commands);
+  }
+
+  return tree;
+}
+
+void getopt_command_tree_free(struct getopt_command_tree* tree) {
+  int i = 0;
+
+  if (tree == NULL)
+    return;
+  for (i = 0; i < tree->num_nodes; ++i)
+    getopt_spec_free(tree->nodes[i].spec);
+  GETOPT_FREE(tree);
+}
+
+/* Returns the index of the subcommand of `node` called name, or -1. */
+static int find_command(const struct getopt_command_tree* tree,
+  const struct getopt_command_node* node, const char* name) {
+  int begin = node->first;
+  int end = node->first + node->num_commands;
+  int middle = 0;
+  int order = 0;
+
+  while (begin < end) {
+    middle = begin + (end - begin) / 2;
+    order = strcmp(name, tree->nodes[middle].command->name);
+    if (order == 0)
+      return middle;
+    if (order < 0)
+      end = middle;
+    else
+      begin = middle + 1;
+  }
+  return -1;
+}
+
+int getopt_command_r(int argc, const char** argv,
+  const struct getopt_command_tree* tree,
+  const struct getopt_command** command, int* longindex,
+  struct getopt_state* state) {
+  const struct getopt_command_node* node = NULL;
+  int flags = state->flags;
+  int found = 0;
+  int retval = 0;
+
+  if (state->optind <= 1)
+    state->command = 0;
+  node = &tree->nodes[state->command];
+
+  /* The first operand of a command with subcommands is one of them, so
+     nothing may be permuted past it. */
+  if (node->num_commands > 0)
+    state->flags |= GETOPT_RETURN_IN_ORDER;
+  retval = getopt_compiled_r(argc, argv, node->spec, longindex, state);
+  state->flags = flags;
+
+  if (retval == 1 && node->num_commands > 0) {
+    found = find_command(tree, node, state->optarg);
+    if (found < 0) {
+      report(argv, state->optind - 1, GETOPT_ERROR_UNKNOWN_COMMAND, 0,
+        state->optvalue.data, state->optvalue.length, 0, state);
       retval = '?';
+    } else {
+      /* Permutation for the subcommand starts after its name. */
+      state->command = found;
+      state->segment = state->optind;
+      state->first_nonopt = state->optind;
+      state->last_nonopt = state->optind;
+      state->num_segments = 0;
+      node = &tree->nodes[found];
+      retval = GETOPT_COMMAND;
+    }
+  }
+
+  if (command)
+    *command = node->command;
+  return retval;
+}
+
+/* An argument read by a stream, in a buffer that grows as needed and is
+   reused for later arguments. */
+struct getopt_token {
+  char* data;
+  size_t length;
+  size_t capacity;
+};
+
+struct getopt_stream {
+  getopt_read_fn read;
+  void* context;
+  void* file;                 /* opened by getopt_stream_open(), or NULL */
+  const struct getopt_spec* spec;
+  int error;
+  int at_end;
+  int operands_only;          /* after "--" or "-" */
+  int index;                  /* number of arguments consumed */
+  int consumed;               /* arguments to drop on the next call */
+  int num_tokens;             /* arguments buffered in tokens */
+  struct getopt_token tokens[2];
+  int begin;                  /* unread input in buffer[begin, end) */
+  int end;
+  char buffer[4096];
+};
+
+struct getopt_stream* getopt_stream_create(getopt_read_fn read,
+  void* context, const struct getopt_spec* spec) {
+  struct getopt_stream* stream =
+    (struct getopt_stream*)GETOPT_MALLOC(sizeof(struct getopt_stream));
+
+  if (stream == NULL)
+    return NULL;
+
+  memset(stream, 0, sizeof(struct getopt_stream));
+  stream->read = read;
+  stream->context = context;
+  stream->spec = spec;
+  return stream;
+}
+
+#if !defined(GETOPT_NO_STDIO)
+static int read_file(void* context, char* buffer, int size) {
+  FILE* file = (FILE*)context;
+  size_t n = fread(buffer, 1, (size_t)size, file);
+
+  if (n == 0 && ferror(file))
+    return -1;
+  return (int)n;
+}
+
+struct getopt_stream* getopt_stream_open(const char* path,
+  const struct getopt_spec* spec) {
+  struct getopt_stream* stream = NULL;
+  FILE* file = fopen(path, "rb");
+
+  if (file == NULL)
+    return NULL;
+
+  stream = getopt_stream_create(read_file, file, spec);
+  if (stream == NULL) {
+    fclose(file);
+    return NULL;
+  }
+  stream->file = file;
+  return stream;
+}
+#endif
+
+void getopt_stream_free(struct getopt_stream* stream) {
+  if (stream == NULL)
+    return;
+
+#if !defined(GETOPT_NO_STDIO)
+  if (stream->file)
+    fclose((FILE*)stream->file);
+#endif
+  GETOPT_FREE(stream->tokens[0].data);
+  GETOPT_FREE(stream->tokens[1].data);
+  GETOPT_FREE(stream);
+}
+
+int getopt_stream_error(const struct getopt_stream* stream) {
+  return stream->error;
+}
+
+/* Returns the next input character, or -1 at the end of the input. */
+static int stream_getc(struct getopt_stream* stream) {
+  if (stream->begin == stream->end) {
+    int n = 0;
+
+    if (stream->at_end)
+      return -1;
+
+    n = stream->read(stream->context, stream->buffer,
+      (int)sizeof(stream->buffer));
+    if (n <= 0) {
+      if (n < 0)
+        stream->error = 1;
+      stream->at_end = 1;
+      return -1;
+    }
+    stream->begin = 0;
+    stream->end = n;
+  }
+  return (unsigned char)stream->buffer[stream->begin++];
+}
+
+/* Appends c to token, growing its buffer by doubling. */
+static int append_char(struct getopt_token* token, char c) {
+  if (token->length == token->capacity) {
+    size_t capacity = token->capacity ? 2 * token->capacity : 64;
+    char* data = (char*)GETOPT_MALLOC(capacity);
+
+    if (data == NULL)
+      return 0;
+    if (token->length > 0)
+      memcpy(data, token->data, token->length);
+    GETOPT_FREE(token->data);
+    token->data = data;
+    token->capacity = capacity;
+  }
+  token->data[token->length++] = c;
+  return 1;
+}
+
+static int is_space(int c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+    c == '\v';
+}
+
+/* Returns nonzero if a backslash before c escapes it in the
+   GETOPT_SPLIT_POSIX rules, outside quotes or, if quote is '"', within
+   double quotes; an escaped newline is then removed altogether. Otherwise
+   the backslash is kept. The splitter and streams share these rules, so
+   that a response file reads the same through either. */
+static int posix_escapes(int c, int quote) {
+  return quote == 0 || (c != '\0' && strchr("$`\"\\\n", c) != NULL);
+}
+
+/* Reads the next argument into token, as getopt_split() with
+   GETOPT_SPLIT_POSIX would. Returns 1, or 0 at the end of the input or on
+   error. An unterminated quote ends at the end of the input. */
+static int read_token(struct getopt_stream* stream,
+  struct getopt_token* token) {
+  int quote = 0;
+  int c = 0;
+  int ok = 1;
+
+  do {
+    c = stream_getc(stream);
+  } while (is_space(c));
+
+  if (c == -1)
+    return 0;
+
+  token->length = 0;
+  for (; c != -1 && ok; c = stream_getc(stream)) {
+    if (quote == '\'') {
+      if (c == '\'') {
+        quote = 0;
+        continue;
+      }
+    } else if (c == '\\') {
+      c = stream_getc(stream);
+      if (c == -1)
+        c = '\\';
+      else if (!posix_escapes(c, quote))
+        ok = append_char(token, '\\');
+      else if (c == '\n')
+        continue;
+    } else if (c == '"' && quote == '"') {
+      quote = 0;
+      continue;
+    } else if (quote == 0) {
+      if (c == '\'' || c == '"') {
+        quote = c;
+        continue;
+      }
+      if (is_space(c))
+        break;
+    }
+
+    ok = ok && append_char(token, (char)c);
+  }
+
+  if (ok && append_char(token, '\0')) {
+    --token->length;
+    return 1;
+  }
+
+  stream->error = 1;
+  stream->at_end = 1;
+  return 0;
+}
+
+/* Drops the arguments consumed by the last call and reads ahead so that
+   the next two are buffered, if there are that many. Buffers are swapped
+   rather than copied, so an option cluster in progress stays in place. */
+static void refill_stream(struct getopt_stream* stream) {
+  struct getopt_token tmp;
+
+  if (stream->consumed >= stream->num_tokens) {
+    stream->num_tokens = 0;
+  } else if (stream->consumed == 1) {
+    tmp = stream->tokens[0];
+    stream->tokens[0] = stream->tokens[1];
+    stream->tokens[1] = tmp;
+    stream->num_tokens = 1;
+  }
+  stream->consumed = 0;
+
+  while (stream->read && stream->num_tokens < 2 &&
+         read_token(stream, &stream->tokens[stream->num_tokens]))
+    ++stream->num_tokens;
+}
+
+int getopt_stream_push(struct getopt_stream* stream, const char* arg,
+  size_t length) {
+  struct getopt_token* token = NULL;
+  size_t i = 0;
+
+  refill_stream(stream);
+  if (stream->read || stream->at_end || stream->num_tokens == 2)
+    return -1;
+
+  token = &stream->tokens[stream->num_tokens];
+  token->length = 0;
+  for (i = 0; i < length; ++i) {
+    if (!append_char(token, arg[i]))
+      break;
+  }
+  if (i < length || !append_char(token, '\0')) {
+    stream->error = 1;
+    return -1;
+  }
+  --token->length;
+  ++stream->num_tokens;
+  return 0;
+}
+
+void getopt_stream_end(struct getopt_stream* stream) {
+  stream->at_end = 1;
+}
+
+/* Returns nonzero if the option at the start of the current argument, or
+   at optcursor, takes the next argument as its option-argument. */
+static int needs_next_argument(const struct getopt_stream* stream,
+  const struct getopt_state* state) {
+  const struct getopt_resolver* resolver = &stream->spec->resolver;
+  const char* token = stream->tokens[0].data;
+  const char* optchar = token + 1;
+  int num_matches = 0;
+  int index = 0;
+
+  if (state->optcursor != NULL && *state->optcursor != '\0') {
+    optchar = state->optcursor;
+  } else if (token[1] == '-' && resolver->longopts != NULL) {
+    if (strchr(token + 2, '=') != NULL)
+      return 0;
+    index = resolver->lookup(resolver->context, token + 2,
+      stream->tokens[0].length - 2, &num_matches);
+    return index >= 0 &&
+      resolver->longopts[index].has_arg == required_argument;
+  }
+
+  return optchar[1] == '\0' &&
+    resolver->shortopts[(unsigned char)*optchar] == required_argument;
+}
+
+int getopt_stream_next(struct getopt_stream* stream, int* longindex,
+  struct getopt_state* state) {
+  const char* argv[3];
+  const char* token = NULL;
+  int argc = 0;
+  int retval = 0;
+
+  for (;;) {
+    refill_stream(stream);
+    if (stream->num_tokens == 0 && !stream->read && !stream->at_end)
+      return GETOPT_PENDING;
+    if (stream->num_tokens == 0) {
+      set_optarg(state, NULL, 0);
+      state->optname.data = NULL;
+      state->optname.length = 0;
+      state->optcursor = NULL;
+      return -1;
+    }
+
+    /* Continue a cluster of short options in the same argument. */
+    if (state->optcursor != NULL && *state->optcursor != '\0')
+      break;
+
+    token = stream->tokens[0].data;
+    if (!stream->operands_only && strcmp(token, "--") == 0) {
+      stream->operands_only = 1;
+      stream->consumed = 1;
+      state->optind = ++stream->index + 1;
+      continue;
+    }
+
+    if (stream->operands_only || token[0] != '-' || token[1] == '\0') {
+      if (token[0] == '-')
+        stream->operands_only = 1;
+      set_optarg(state, token, stream->tokens[0].length);
+      state->optname.data = NULL;
+      state->optname.length = 0;
+      state->optopt = 0;
+      stream->consumed = 1;
+      state->optind = ++stream->index + 1;
+      return 1;
     }
+    break;
+  }
+
+  /* A pushed argument may have to wait for the next. */
+  if (!stream->read && !stream->at_end && stream->num_tokens == 1 &&
+      needs_next_argument(stream, state))
+    return GETOPT_PENDING;
+
+  /* Parse from a window of the current and the next argument. */
+  argv[0] = "";
+  argv[1] = stream->tokens[0].data;
+  argv[2] = stream->num_tokens > 1 ? stream->tokens[1].data : NULL;
+  argc = stream->num_tokens + 1;
+
+  state->flags |= GETOPT_RETURN_IN_ORDER;
+  state->optind = 1;
+  state->index_base = stream->index;
+  retval = getopt_compiled_r(argc, argv, stream->spec, longindex, state);
+
+  stream->consumed = (state->optind > argc ? argc : state->optind) - 1;
+  stream->index += stream->consumed;
+
+  /* The next refill reuses the buffers of consumed arguments, so a cursor
+     left at the end of a finished cluster must not survive it. */
+  if (stream->consumed > 0)
+    state->optcursor = NULL;
+  state->optind = stream->index + 1;
+  return retval;
+}
+
+/* Returns the number of bytes at the start of s, up to length, that are
+   none of c1, c2 and c3, nor whitespace if `spaces` is set. Quoted or not,
+   arguments tend to be long runs of such bytes, which the splitter copies
+   in one go; with SSE2 they are found 16 bytes at a time. */
+static size_t span_plain(const char* s, size_t length, int spaces, char c1,
+  char c2, char c3) {
+  size_t i = 0;
+
+#if defined(GETOPT_SSE2)
+  const __m128i v1 = _mm_set1_epi8(c1);
+  const __m128i v2 = _mm_set1_epi8(c2);
+  const __m128i v3 = _mm_set1_epi8(c3);
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i before_tab = _mm_set1_epi8(-1);
+  const __m128i after_cr = _mm_set1_epi8(5);
+  __m128i block;
+  __m128i hits;
+  __m128i control;
+  unsigned mask = 0;
+
+  for (; length - i >= 16; i += 16) {
+    block = _mm_loadu_si128((const __m128i*)(s + i));
+    hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v1),
+      _mm_cmpeq_epi8(block, v2)), _mm_cmpeq_epi8(block, v3));
+    if (spaces) {
+      /* '\t' through '\r' are 0 through 4 after subtracting '\t', and every
+         other byte is negative or above 4 as a signed byte. */
+      control = _mm_sub_epi8(block, tab);
+      hits = _mm_or_si128(hits, _mm_or_si128(_mm_cmpeq_epi8(block, space),
+        _mm_and_si128(_mm_cmpgt_epi8(control, before_tab),
+        _mm_cmplt_epi8(control, after_cr))));
+    }
+    mask = (unsigned)_mm_movemask_epi8(hits);
+    if (mask != 0)
+      return i + (size_t)lowest_bit(mask);
+  }
+#endif
+
+  for (; i < length; ++i) {
+    if (s[i] == c1 || s[i] == c2 || s[i] == c3 ||
+        (spaces && is_space((unsigned char)s[i])))
+      break;
+  }
+  return i;
+}
+
+/* Handles the byte at *p in the POSIX rules, which span_plain() stopped
+   at, updating *quote. */
+static void split_posix(const char** p, const char* end, char** out,
+  char* quote) {
+  char c = *(*p)++;
+
+  if (*quote == '\'') {
+    if (c == '\'')
+      *quote = '\0';
+    else
+      *(*out)++ = c;
+  } else if (c == '\\') {
+    if (*p == end || !posix_escapes((unsigned char)**p, *quote)) {
+      *(*out)++ = c;
+    } else if (**p == '\n') {
+      ++*p;
+    } else {
+      *(*out)++ = *(*p)++;
+    }
+  } else if (c == '"' || (c == '\'' && *quote == '\0')) {
+    *quote = *quote == c ? '\0' : c;
   } else {
-    /* Unknown option or ambiguous match. */
-    retval = '?';
-    if (num_matches == 0) {
-      if (opterr)
-        fprintf(stderr, "%s: unrecognized option -- '%s'\n", argv[0], argv[optind]);
+    *(*out)++ = c;
+  }
+}
+
+/* Handles the byte at *p in the Windows rules, as split_posix(). */
+static void split_windows(const char** p, const char* end, char** out,
+  char* quote) {
+  const char* backslashes = *p;
+  size_t n = 0;
+
+  if (**p == '\\') {
+    while (*p < end && **p == '\\')
+      ++*p;
+    n = (size_t)(*p - backslashes);
+    if (*p < end && **p == '"') {
+      memset(*out, '\\', n / 2);
+      *out += n / 2;
+      if (n % 2 == 1)
+        *(*out)++ = *(*p)++;
     } else {
-      if (opterr)
-        fprintf(stderr, "%s: option '%s' is ambiguous\n", argv[0], argv[optind]);
+      memset(*out, '\\', n);
+      *out += n;
+    }
+  } else if (**p == '"') {
+    if (*quote && *p + 1 < end && (*p)[1] == '"') {
+      *(*out)++ = '"';
+      *p += 2;
+    } else {
+      *quote = *quote ? '\0' : '"';
+      ++*p;
+    }
+  } else {
+    *(*out)++ = *(*p)++;
+  }
+}
+
+int getopt_split(const char* line, size_t length, int rules, char* buffer,
+  const char** argv, int max_args) {
+  const char* p = line;
+  const char* end = line + length;
+  char* out = buffer;
+  char* token = NULL;
+  char quote = '\0';
+  size_t run = 0;
+  int argc = 0;
+
+  /* The program name ends at unquoted whitespace, and quotes only group. */
+  if (rules == GETOPT_SPLIT_WINDOWS) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    for (; p < end && (quote || (*p != ' ' && *p != '\t')); ++p) {
+      token = buffer;
+      if (*p == '"')
+        quote = quote ? '\0' : '"';
+      else
+        *out++ = *p;
+    }
+    quote = '\0';
+    if (token != NULL) {
+      /* Step over the separator first, so that the terminator written in
+         place never lands ahead of the input still to be read. */
+      if (p < end)
+        ++p;
+      *out++ = '\0';
+      if (argc < max_args)
+        argv[argc] = token;
+      ++argc;
+      token = NULL;
+    }
+  }
+
+  while (p < end) {
+    if (quote == '\'')
+      run = span_plain(p, (size_t)(end - p), 0, '\'', '\'', '\'');
+    else if (quote)
+      run = span_plain(p, (size_t)(end - p), 0, '"', '\\', '"');
+    else
+      run = span_plain(p, (size_t)(end - p), 1, '\'', '"', '\\');
+    if (run > 0) {
+      if (token == NULL)
+        token = out;
+      memmove(out, p, run);
+      out += run;
+      p += run;
+      continue;
+    }
+
+    if (quote != '\0' || (rules == GETOPT_SPLIT_WINDOWS ?
+        *p != ' ' && *p != '\t' : !is_space((unsigned char)*p))) {
+      if (token == NULL)
+        token = out;
+      if (rules == GETOPT_SPLIT_WINDOWS)
+        split_windows(&p, end, &out, &quote);
+      else
+        split_posix(&p, end, &out, &quote);
+      continue;
+    }
+
+    ++p;
+    if (token == NULL)
+      continue;
+    *out++ = '\0';
+    if (argc < max_args)
+      argv[argc] = token;
+    ++argc;
+    token = NULL;
+  }
+
+  if (quote && rules == GETOPT_SPLIT_POSIX)
+    return -1;
+  if (token != NULL) {
+    *out = '\0';
+    if (argc < max_args)
+      argv[argc] = token;
+    ++argc;
+  }
+  if (argc < max_args)
+    argv[argc] = NULL;
+  return argc;
+}
+
+/* Notes the option whose argument is missing from the words before the
+   one being completed. */
+struct getopt_pending {
+  int index;
+  int longopt;
+  struct getopt_slice option;
+};
+
+static void note_missing(void* context,
+  const struct getopt_diagnostic* diagnostic) {
+  struct getopt_pending* pending = (struct getopt_pending*)context;
+
+  if (diagnostic->error == GETOPT_ERROR_MISSING_ARGUMENT) {
+    pending->index = diagnostic->index;
+    pending->longopt = diagnostic->longopt;
+    pending->option = diagnostic->option;
+  }
+}
+
+/* Returns what the parser returns for the option named by the `length`
+   characters at name, or by the character at name if it is not longopt. */
+static int option_id(const struct getopt_spec* spec, int longopt,
+  const char* name, size_t length) {
+  const struct option* o = NULL;
+  int num_matches = 0;
+  int index = 0;
+
+  if (!longopt)
+    return (unsigned char)*name;
+
+  index = getopt_spec_lookup(spec, name, length, &num_matches);
+  if (index < 0)
+    return -1;
+  o = &spec->resolver.longopts[index];
+  return o->flag ? 0 : o->val;
+}
+
+/* Emits the keywords of option `id` that start with prefix. */
+static int complete_values(const struct getopt_value* values, int id,
+  const char* prefix, size_t length, getopt_complete_fn emit,
+  void* context) {
+  const char* const* name = NULL;
+  int count = 0;
+
+  for (; values != NULL && values->type != 0; ++values) {
+    if (values->id != id || values->type != GETOPT_TYPE_ENUM)
+      continue;
+    for (name = values->keywords->names; *name != NULL; ++name) {
+      if (strncmp(*name, prefix, length) == 0) {
+        emit(context, "", *name, strlen(*name));
+        ++count;
+      }
     }
+    break;
+  }
+  return count;
+}
+
+/* Emits the long options, and for a lone "-" the short ones too, that
+   start with the word. */
+static int complete_options(const struct getopt_spec* spec, const char* word,
+  getopt_complete_fn emit, void* context) {
+  const struct option* longopts = spec->resolver.longopts;
+  const char* optstring = spec->resolver.optstring;
+  const int* matches = NULL;
+  int num_matches = 0;
+  int count = 0;
+  int i = 0;
+
+  if (word[1] == '\0') {
+    if (*optstring == '+' || *optstring == '-')
+      ++optstring;
+    for (; *optstring != '\0'; ++optstring) {
+      if (*optstring != ':' && spec->shortopts[(unsigned char)*optstring] &&
+          strchr(spec->resolver.optstring, *optstring) == optstring) {
+        emit(context, "-", optstring, 1);
+        ++count;
+      }
+    }
+  }
+
+  num_matches = getopt_spec_complete(spec, word + 2 - (word[1] != '-'),
+    strlen(word + 2 - (word[1] != '-')), &matches);
+  for (i = 0; i < num_matches; ++i) {
+    /* Duplicate names sort next to each other. */
+    if (i > 0 &&
+        strcmp(longopts[matches[i]].name, longopts[matches[i - 1]].name) == 0)
+      continue;
+    emit(context, "--", longopts[matches[i]].name,
+      strlen(longopts[matches[i]].name));
+    ++count;
+  }
+  return count;
+}
+
+/* Emits the subcommands of node that start with prefix, which are
+   adjacent in their sorted list. */
+static int complete_commands(const struct getopt_command_tree* tree,
+  const struct getopt_command_node* node, const char* prefix,
+  getopt_complete_fn emit, void* context) {
+  size_t length = strlen(prefix);
+  int begin = node->first;
+  int end = node->first + node->num_commands;
+  int middle = 0;
+  int count = 0;
+
+  while (begin < end) {
+    middle = begin + (end - begin) / 2;
+    if (strncmp(tree->nodes[middle].command->name, prefix, length) < 0)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+
+  for (end = node->first + node->num_commands; begin < end; ++begin) {
+    const char* name = tree->nodes[begin].command->name;
+    if (strncmp(name, prefix, length) != 0)
+      break;
+    emit(context, "", name, strlen(name));
+    ++count;
+  }
+  return count;
+}
+
+int getopt_complete(const struct getopt_command_tree* tree,
+  const struct getopt_value* values, int argc, const char** argv,
+  getopt_complete_fn emit, void* context) {
+  const struct getopt_command_node* node = NULL;
+  const char* word = argv[argc - 1];
+  const char* equals = NULL;
+  const char* last_optarg = NULL;
+  struct getopt_pending pending;
+  struct getopt_state state;
+  int id = 0;
+
+  /* Find the command and any option waiting for its argument, without
+     writing to argv or to the values. */
+  memset(&pending, 0, sizeof(pending));
+  pending.index = -1;
+  memset(&state, 0, sizeof(state));
+  state.optind = 1;
+  state.flags = GETOPT_RETURN_IN_ORDER;
+  state.diagnose = note_missing;
+  state.diagnose_context = &pending;
+  while (getopt_command_r(argc - 1, argv, tree, NULL, NULL, &state) != -1)
+    last_optarg = state.optarg;
+  node = &tree->nodes[state.command];
+
+  if (pending.index == argc - 2) {
+    id = option_id(node->spec, pending.longopt, pending.option.data,
+      pending.option.length);
+    return complete_values(values, id, word, strlen(word), emit, context);
+  }
+
+  /* After "--", everything is an operand. */
+  if (state.optind < argc - 1 || (state.optind > 1 &&
+      strcmp(argv[state.optind - 1], "--") == 0 &&
+      argv[state.optind - 1] != last_optarg))
+    return 0;
+
+  /* A word of "--" is the empty prefix of every long option. */
+  if (word[0] == '-' && word[1] == '-') {
+    equals = strchr(word, '=');
+    if (equals == NULL)
+      return complete_options(node->spec, word, emit, context);
+    id = option_id(node->spec, 1, word + 2, (size_t)(equals - word - 2));
+    return complete_values(values, id, equals + 1, strlen(equals + 1), emit,
+      context);
   }
+  if (word[0] == '-')
+    return word[1] == '\0' ? complete_options(node->spec, word, emit,
+      context) : 0;
+  return complete_commands(tree, node, word, emit, context);
+}
+
+#if !defined(GETOPT_NO_STDIO)
+static void print_candidate(void* context, const char* prefix,
+  const char* candidate, size_t length) {
+  (void)context;
+  printf("%s%.*s\n", prefix, (int)length, candidate);
+}
+
+int getopt_complete_main(const struct getopt_command_tree* tree,
+  const struct getopt_value* values) {
+  const char* line = getenv("COMP_LINE");
+  const char* point = getenv("COMP_POINT");
+  size_t length = 0;
+  char* buffer = NULL;
+  const char** argv = NULL;
+  int argc = 0;
+
+  if (line == NULL)
+    return 0;
+
+  length = strlen(line);
+  if (point != NULL && strtoul(point, NULL, 10) < length)
+    length = strtoul(point, NULL, 10);
+
+  /* Every argument but the last takes at least two characters. */
+  buffer = (char*)GETOPT_MALLOC(length + 1);
+  argv = (const char**)GETOPT_MALLOC((length + 3) * sizeof(const char*));
+  if (buffer != NULL && argv != NULL) {
+    argc = getopt_split(line, length, GETOPT_SPLIT_POSIX, buffer, argv,
+      (int)length + 2);
+
+    /* After a space, a new argument is being started. */
+    if (argc >= 0 && (length == 0 || (is_space((unsigned char)line[length - 1])
+        && (length == 1 || line[length - 2] != '\\'))))
+      argv[argc++] = "";
+    if (argc >= 2)
+      getopt_complete(tree, values, argc, argv, print_candidate, NULL);
+    fflush(stdout);
+  }
+
+  GETOPT_FREE(argv);
+  GETOPT_FREE(buffer);
+  return 1;
+}
+#endif
+
+static void load_global_state(void) {
+  /* As with glibc, the environment decides at the start of every scan. */
+  if (optind <= 1) {
+    global_state.flags = getenv("POSIXLY_CORRECT") != NULL ?
+      GETOPT_REQUIRE_ORDER : 0;
+  }
+  global_state.optind = optind;
+  global_state.opterr = opterr;
+}
 
-  ++optind;
+static void store_global_state(void) {
+  optarg = global_state.optarg;
+  optind = global_state.optind;
+  opterr = global_state.opterr;
+  optopt = global_state.optopt;
+}
+
+int getopt(int argc, const char** argv, const char* optstring) {
+  int retval;
+
+  load_global_state();
+  retval = getopt_r(argc, argv, optstring, &global_state);
+  store_global_state();
   return retval;
+}
 
-no_more_optchars:
-  first = NULL;
-  return -1;
+int getopt_long(int argc, const char** argv, const char* optstring,
+  const struct option* longopts, int* longindex) {
+  int retval;
+
+  load_global_state();
+  retval = getopt_long_r(argc, argv, optstring, longopts, longindex,
+    &global_state);
+  store_global_state();
+  return retval;
+}
+
+int getopt_compiled(int argc, const char** argv,
+  const struct getopt_spec* spec, int* longindex) {
+  int retval;
+
+  load_global_state();
+  retval = getopt_compiled_r(argc, argv, spec, longindex, &global_state);
+  store_global_state();
+  return retval;
 }
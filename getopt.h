@@ -29,6 +29,8 @@
 #ifndef INCLUDED_GETOPT_PORT_H
 #define INCLUDED_GETOPT_PORT_H
 
+#include <stddef.h>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -37,6 +39,25 @@ extern "C" {
 #define required_argument 2
 #define optional_argument 3
 
+#define GETOPT_MAX_SEGMENTS 32
+
+/* Flags for getopt_state.
+
+   GETOPT_RETURN_IN_ORDER: Never permute argv. Non-options are returned in
+   place, as if they were an option with character code 1 and the
+   non-option as its argument; optind - 1 is then their index. argv is not
+   written to, so it may point to read-only memory.
+
+   GETOPT_REQUIRE_ORDER: Never permute argv. Parsing stops at the first
+   non-option, as POSIX requires, with optind pointing at it; argv is not
+   written to either. getopt() and getopt_long() use this mode if the
+   environment has POSIXLY_CORRECT when a scan starts.
+
+   A '-' or '+' at the start of optstring selects GETOPT_RETURN_IN_ORDER
+   or GETOPT_REQUIRE_ORDER respectively, as with GNU getopt(). */
+#define GETOPT_RETURN_IN_ORDER 0x1
+#define GETOPT_REQUIRE_ORDER 0x2
+
 extern const char* optarg;
 extern int optind, opterr, optopt;
 
@@ -47,11 +68,406 @@ struct option {
   int val;
 };
 
+/* A string with its length; not necessarily NUL-terminated. */
+struct getopt_slice {
+  const char* data;
+  size_t length;
+};
+
+/* Errors reported through getopt_state.diagnose. */
+#define GETOPT_ERROR_UNKNOWN_OPTION 1      /* not in optstring or longopts */
+#define GETOPT_ERROR_AMBIGUOUS_OPTION 2    /* abbreviates several options */
+#define GETOPT_ERROR_MISSING_ARGUMENT 3    /* required argument not given */
+#define GETOPT_ERROR_UNEXPECTED_ARGUMENT 4 /* --name=value for no_argument */
+#define GETOPT_ERROR_UNKNOWN_COMMAND 5     /* not a subcommand, see below */
+#define GETOPT_ERROR_INVALID_VALUE 6       /* not of the option's type */
+#define GETOPT_ERROR_OUT_OF_RANGE 7        /* too large or outside [min, max] */
+
+struct getopt_diagnostic {
+  int error;                  /* GETOPT_ERROR_* */
+  int index;                  /* argv index of the option */
+  int longopt;                /* nonzero for --name, zero for -c */
+  struct getopt_slice option; /* the option as written, without dashes */
+  int num_matches;            /* for GETOPT_ERROR_AMBIGUOUS_OPTION */
+  const char* progname;       /* argv[0] */
+  struct getopt_slice value;  /* the option-argument, or NULL data */
+  const char* const* keywords; /* the valid values for an enum, or NULL */
+  const char* suggestion;     /* for an unknown --name, a close long option
+                                 name it may have been meant as, or NULL */
+};
+
+typedef void (*getopt_diagnose_fn)(void* context,
+  const struct getopt_diagnostic* diagnostic);
+
+#if !defined(GETOPT_NO_STDIO)
+/* A diagnose callback that prints GNU-style messages to stderr. */
+void getopt_diagnose_stderr(void* context,
+  const struct getopt_diagnostic* diagnostic);
+#endif
+
+/* Counters kept in getopt_state.stats when getopt.c is built with
+   GETOPT_INSTRUMENT; otherwise they are never touched. They accumulate over
+   parses until reset by the caller. */
+struct getopt_stats {
+  unsigned long exchanges;     /* block exchanges permuting argv */
+  unsigned long moves;         /* argv elements in the exchanged blocks */
+  unsigned long lookups;       /* long option names resolved */
+  unsigned long comparisons;   /* names compared, or trie nodes visited */
+  unsigned long abbreviations; /* lookups matching an abbreviation */
+  unsigned long errors[8];     /* indexed by GETOPT_ERROR_* */
+};
+
+/* Events passed to getopt_state.trace with GETOPT_INSTRUMENT. */
+#define GETOPT_TRACE_EXCHANGE 1 /* value: argv elements exchanged */
+#define GETOPT_TRACE_LOOKUP 2   /* value: comparisons for the lookup */
+#define GETOPT_TRACE_ERROR 3    /* value: GETOPT_ERROR_* */
+
+/* index is the argv index of the option involved, or the first argv
+   element exchanged. */
+typedef void (*getopt_trace_fn)(void* context, int event, int index,
+  unsigned long value);
+
+/* Types of option-arguments, see struct getopt_value. */
+#define GETOPT_TYPE_INT 1      /* long long: decimal, within [min, max] */
+#define GETOPT_TYPE_DOUBLE 2   /* double: decimal, with an exponent */
+#define GETOPT_TYPE_SIZE 3     /* unsigned long long: K, M, G or T suffix */
+#define GETOPT_TYPE_DURATION 4 /* long long nanoseconds: ns, us, ms, s, m
+                                  or h suffix, seconds if there is none */
+#define GETOPT_TYPE_ENUM 5     /* int: the index of the keyword */
+
+/* A fixed set of keywords, and a function that returns the index of the
+   `length` characters at s among them, or -1 if they are not one. */
+struct getopt_keywords {
+  const char* const* names;   /* NULL-terminated */
+  int (*lookup)(const void* context, const char* s, size_t length);
+  const void* context;
+};
+
+/* Builds a minimal perfect hash of names, which it refers to but does not
+   copy, so that a keyword is found with one hash and one comparison.
+   getopt.hpp builds them at compile time. Returns NULL if out of memory,
+   or if names has duplicates. */
+struct getopt_keywords* getopt_keywords_compile(const char* const* names);
+
+void getopt_keywords_free(struct getopt_keywords* keywords);
+
+/* Declares the type of the option-argument of the option with the given
+   id, which is what the parser returns for it, and where the converted
+   value is stored. Sizes are in powers of 1024, and durations may have a
+   decimal fraction, as in "1.5s". The range of GETOPT_TYPE_INT is only
+   checked unless min and max are both 0. Numbers are parsed without
+   regard to the locale. */
+struct getopt_value {
+  int id;
+  int type;                   /* GETOPT_TYPE_*; 0 ends a list */
+  void* storage;
+  long long min;
+  long long max;
+  const struct getopt_keywords* keywords; /* for GETOPT_TYPE_ENUM */
+};
+
+/* Parser state for the reentrant getopt_r() and getopt_long_r().
+   The public members mirror the globals of the same name; the rest is
+   private bookkeeping. A zero-initialized struct is ready for use, and
+   setting optind to 1 or less restarts the scan, just like the globals. */
+struct getopt_state {
+  const char* optarg;
+  int optind;
+  int opterr;
+  int optopt;
+  int flags;
+
+  /* The last option as written, without its dashes or "=value", and its
+     option-argument (the same as optarg), or NULL data if there is none. */
+  struct getopt_slice optname;
+  struct getopt_slice optvalue;
+
+  /* Called with diagnose_context for every erroneous option, before '?' or
+     ':' is returned. Nothing is reported if diagnose is NULL. */
+  getopt_diagnose_fn diagnose;
+  void* diagnose_context;
+
+  /* If not NULL, the option-arguments of the options listed here are
+     converted and stored as soon as they are found. An argument that does
+     not convert is diagnosed, and '?' is returned instead of the option.
+     Options that set a flag, and return 0, cannot be listed. */
+  const struct getopt_value* values;
+
+  /* Instrumentation, if compiled in; see struct getopt_stats. */
+  struct getopt_stats* stats;
+  getopt_trace_fn trace;
+  void* trace_context;
+
+  /* private */
+  const char* optcursor;
+  int index_base;             /* added to diagnostic indices */
+  int command;                /* current node for getopt_command_r() */
+  int first_nonopt;
+  int last_nonopt;
+  int segment;
+  int num_segments;
+  int segments[GETOPT_MAX_SEGMENTS][2];
+};
+
 int getopt(int argc, const char** argv, const char* optstring);
 
 int getopt_long(int argc, const char** argv,
   const char* optstring, const struct option* longopts, int* longindex);
 
+int getopt_r(int argc, const char** argv, const char* optstring,
+  struct getopt_state* state);
+
+int getopt_long_r(int argc, const char** argv,
+  const char* optstring, const struct option* longopts, int* longindex,
+  struct getopt_state* state);
+
+/* An immutable, precompiled form of an optstring and long option table,
+   which can be shared by any number of parses, also concurrently. Short
+   options are classified by table lookup, and long option names are
+   resolved in time proportional to their length.
+   The spec refers to, but does not copy, optstring and longopts.
+   If longopts is NULL, parsing follows getopt() rather than getopt_long().
+   Returns NULL if out of memory. */
+struct getopt_spec;
+
+struct getopt_spec* getopt_compile(const char* optstring,
+  const struct option* longopts);
+
+void getopt_spec_free(struct getopt_spec* spec);
+
+/* Returns how optchar is declared: no_argument, required_argument,
+   optional_argument, or 0 if it is not a short option. */
+int getopt_spec_short(const struct getopt_spec* spec, int optchar);
+
+/* Resolves the first `length` characters of name as a long option name or
+   unique abbreviation. Returns its index in longopts, or -1 if there is no
+   match (*num_matches is 0) or several (*num_matches is their count). */
+int getopt_spec_lookup(const struct getopt_spec* spec, const char* name,
+  size_t length, int* num_matches);
+
+/* Points *matches at the longopts indices of every long option whose name
+   starts with the first `length` characters of prefix, in name order, and
+   returns how many there are. Takes time in the length of the prefix, not
+   in the number of options. */
+int getopt_spec_complete(const struct getopt_spec* spec, const char* prefix,
+  size_t length, const int** matches);
+
+/* Finds the long options whose names are at most max_distance edits
+   (insertions, deletions or substitutions) from the `length` characters
+   of name, which is at most 64 characters long. Stores the longopts
+   indices of the closest, up to max_indices and GETOPT_MAX_SUGGESTIONS of
+   them, to indices in order of distance and then of longopts, and returns
+   how many there are. Each name costs one machine word operation per
+   character, and is abandoned as soon as it cannot be close enough. */
+int getopt_suggest(const struct option* longopts, const char* name,
+  size_t length, int max_distance, int* indices, int max_indices);
+
+#define GETOPT_MAX_SUGGESTIONS 16
+
+int getopt_compiled(int argc, const char** argv,
+  const struct getopt_spec* spec, int* longindex);
+
+int getopt_compiled_r(int argc, const char** argv,
+  const struct getopt_spec* spec, int* longindex, struct getopt_state* state);
+
+/* The tables a parse is driven by: how each short option character is
+   declared, as by getopt_spec_short(), and a function that resolves long
+   option names like getopt_spec_lookup(). A getopt_spec is one resolver;
+   getopt.hpp generates others at compile time. If longopts is NULL, lookup
+   is never called and parsing follows getopt(). */
+struct getopt_resolver {
+  const char* optstring;
+  const struct option* longopts;
+  const unsigned char* shortopts;   /* 256 entries */
+  int (*lookup)(const void* context, const char* name, size_t length,
+    int* num_matches);
+  const void* context;
+};
+
+int getopt_resolved_r(int argc, const char** argv,
+  const struct getopt_resolver* resolver, int* longindex,
+  struct getopt_state* state);
+
+/* The resolver of a spec, valid for as long as the spec. */
+const struct getopt_resolver* getopt_spec_resolver(
+  const struct getopt_spec* spec);
+
+/* An option found by getopt_parse(). */
+struct getopt_record {
+  int id;           /* what getopt_compiled() would have returned */
+  int longindex;    /* index in longopts, or -1 for a short option */
+  int index;        /* argv index of the option */
+  const char* arg;  /* option-argument, or NULL */
+  size_t arg_length; /* length of arg, without scanning for the NUL */
+};
+
+/* Caller-provided storage for getopt_parse(). On return, num_records and
+   num_operands hold the number of options and operands found, even if
+   they exceeded max_records or max_operands. */
+struct getopt_result {
+  struct getopt_record* records;
+  int max_records;
+  int num_records;
+  int* operands;    /* argv indices of the operands, in order */
+  int max_operands;
+  int num_operands;
+};
+
+/* Parses all of argv in one call. argv is not modified. Returns 0, or -1 if
+   result did not have room for everything, in which case the first
+   max_records records and max_operands operands are filled in. */
+int getopt_parse(int argc, const char* const* argv,
+  const struct getopt_spec* spec, struct getopt_result* result);
+
+int getopt_parse_resolved(int argc, const char* const* argv,
+  const struct getopt_resolver* resolver, struct getopt_result* result);
+
+/* A command with its options and subcommands, git-style: in
+   "prog -v remote add --tags origin", -v is parsed by the options of prog,
+   and --tags by those of the subcommand "add" of its subcommand "remote".
+   A list of subcommands ends with a NULL name; commands is NULL if there
+   are none. optstring and longopts are as for getopt_compile(), and id is
+   for the caller to dispatch on. */
+struct getopt_command {
+  const char* name;
+  const char* optstring;
+  const struct option* longopts;
+  const struct getopt_command* commands;
+  int id;
+};
+
+/* An immutable, precompiled form of a command tree, with a getopt_spec for
+   each command and its subcommands sorted for lookup by binary search.
+   It refers to, but does not copy, the commands. Returns NULL if out of
+   memory. */
+struct getopt_command_tree;
+
+struct getopt_command_tree* getopt_command_compile(
+  const struct getopt_command* root);
+
+void getopt_command_tree_free(struct getopt_command_tree* tree);
+
+/* Like getopt_compiled_r(), with the options of the current command, which
+   starts out as the root. Options and operands are not permuted past a
+   command that has subcommands, and its first operand names one of them;
+   it becomes the current command, GETOPT_COMMAND is returned and optarg
+   is the name. If there is no such subcommand, '?' is returned after
+   GETOPT_ERROR_UNKNOWN_COMMAND is reported. Operands of a command without
+   subcommands are handled as by getopt_compiled_r(). If command is not
+   NULL, it is set to the current command on every return. */
+int getopt_command_r(int argc, const char** argv,
+  const struct getopt_command_tree* tree,
+  const struct getopt_command** command, int* longindex,
+  struct getopt_state* state);
+
+#define GETOPT_COMMAND (-3)
+
+/* Reads up to size bytes of input into buffer. Returns the number of bytes
+   read, 0 at the end of the input, or a negative number on error. */
+typedef int (*getopt_read_fn)(void* context, char* buffer, int size);
+
+/* Parses arguments read incrementally from a response file or any other
+   source, without ever holding more than two of them in memory. The input
+   is split into arguments by the GETOPT_SPLIT_POSIX rules of
+   getopt_split(), except that a quote left open ends with the input.
+   Operands are returned in order as 1, as with GETOPT_RETURN_IN_ORDER, and
+   everything after "--" or "-" is an operand.
+   If read is NULL, arguments are instead pushed one at a time with
+   getopt_stream_push() as they become available.
+   Returns NULL if out of memory, or if the file cannot be opened. */
+struct getopt_stream;
+
+struct getopt_stream* getopt_stream_create(getopt_read_fn read,
+  void* context, const struct getopt_spec* spec);
+
+#if !defined(GETOPT_NO_STDIO)
+struct getopt_stream* getopt_stream_open(const char* path,
+  const struct getopt_spec* spec);
+#endif
+
+void getopt_stream_free(struct getopt_stream* stream);
+
+/* Like getopt_compiled_r(), on the next arguments of the stream. state must
+   be zero-initialized and only used with this stream; state->optind counts
+   the arguments consumed, starting from 1. optarg and the slices in state
+   remain valid until the next call. Returns -1 at the end of the input, or
+   for a pushed stream, GETOPT_PENDING when all pushed arguments have been
+   parsed or the last one needs the next as its option-argument. */
+int getopt_stream_next(struct getopt_stream* stream, int* longindex,
+  struct getopt_state* state);
+
+#define GETOPT_PENDING (-2)
+
+/* Copies an argument of `length` bytes into a stream created without a
+   read function. Everything the stream state needs carries over between
+   arguments: the position in an option cluster, a pending option-argument
+   and whether "--" was seen, so each argument is parsed once. Call
+   getopt_stream_next() until it returns GETOPT_PENDING before pushing
+   more. Returns 0, or -1 if the stream still holds two unparsed
+   arguments, has ended, or is out of memory. */
+int getopt_stream_push(struct getopt_stream* stream, const char* arg,
+  size_t length);
+
+/* Marks the end of the pushed arguments, after which getopt_stream_next()
+   reports a missing option-argument and then returns -1. */
+void getopt_stream_end(struct getopt_stream* stream);
+
+/* Returns nonzero if the stream ended early because of a read error or
+   because it ran out of memory. */
+int getopt_stream_error(const struct getopt_stream* stream);
+
+/* Quoting rules for getopt_split().
+
+   GETOPT_SPLIT_POSIX: Arguments are separated by unquoted whitespace.
+   Single quotes preserve everything up to the closing quote. A backslash
+   escapes the next character, or inside double quotes the next '$', '`',
+   '"', '\' or newline, and a backslash-newline is removed. There are no
+   expansions.
+
+   GETOPT_SPLIT_WINDOWS: As CommandLineToArgvW() and the Microsoft C
+   runtime. Arguments are separated by unquoted spaces and tabs, and double
+   quotes group them. 2n backslashes before a '"' stand for n backslashes,
+   and 2n + 1 for n and a literal '"'; other backslashes are literal, and
+   inside quotes "" is a literal '"'. The first argument, the program name,
+   has no escapes. */
+#define GETOPT_SPLIT_POSIX 0
+#define GETOPT_SPLIT_WINDOWS 1
+
+/* Splits the `length` characters of line into arguments, unquoted and
+   NUL-terminated, written one after the other to buffer, which needs room
+   for length + 1 characters and may be line itself. Pointers to them go
+   to argv, followed by NULL if there is room, ready for the parsers: the
+   first argument takes the place of the program name. Returns the number
+   of arguments, even if it is more than max_args and only the first
+   max_args were stored, or -1 if a POSIX quote is not closed. */
+int getopt_split(const char* line, size_t length, int rules, char* buffer,
+  const char** argv, int max_args);
+
+/* Receives a completion: the `length` characters of candidate, to be
+   shown after prefix ("--" for long options, "-" for short ones). */
+typedef void (*getopt_complete_fn)(void* context, const char* prefix,
+  const char* candidate, size_t length);
+
+/* Completes argv[argc - 1] in the context of the arguments before it,
+   emitting every candidate it could be: the keywords of a
+   GETOPT_TYPE_ENUM option in values when it is that option's argument,
+   also after "--name=", the long options of the current command starting
+   with it when it starts with "--", all its options when it is "-", or
+   otherwise its subcommands. Neither argv nor the storage in values is
+   written. values may be NULL. Returns the number of candidates. */
+int getopt_complete(const struct getopt_command_tree* tree,
+  const struct getopt_value* values, int argc, const char** argv,
+  getopt_complete_fn emit, void* context);
+
+#if !defined(GETOPT_NO_STDIO)
+/* Answers bash programmable completion, for a program registered with
+   `complete -C program program`: if COMP_LINE is set, prints the
+   candidates for its word at COMP_POINT one per line and returns 1, and
+   the program should exit; otherwise returns 0. Call it first in main(). */
+int getopt_complete_main(const struct getopt_command_tree* tree,
+  const struct getopt_value* values);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
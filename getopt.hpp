@@ -0,0 +1,524 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#ifndef INCLUDED_GETOPT_PORT_HPP
+#define INCLUDED_GETOPT_PORT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+
+#include "getopt.h"
+
+namespace getopt_port {
+
+inline std::string_view to_string_view(const getopt_slice& slice) {
+  if (slice.data == nullptr)
+    return std::string_view();
+
+  return std::string_view(slice.data, slice.length);
+}
+
+// The last option parsed with state, as written on the command line, without
+// dashes or "=value".
+inline std::string_view option_name(const getopt_state& state) {
+  return to_string_view(state.optname);
+}
+
+// The option-argument of the last option parsed with state. data() is
+// nullptr if there was none, so an empty "--name=" can be told apart.
+inline std::string_view option_value(const getopt_state& state) {
+  return to_string_view(state.optvalue);
+}
+
+inline std::string_view option_value(const getopt_record& record) {
+  if (record.arg == nullptr)
+    return std::string_view();
+
+  return std::string_view(record.arg, record.arg_length);
+}
+
+// An option table fixed at compile time, parsed with the same grammar as
+// getopt_long(). Declared constexpr, the constructor builds the short
+// option table and a hash table of the long option names during
+// compilation, and a duplicate or malformed name fails to compile:
+//
+//   constexpr option opts[] = {
+//     {"output", required_argument, nullptr, 'o'},
+//     {"verbose", no_argument, nullptr, 'v'},
+//   };
+//   constexpr getopt_port::schema cli("o:v", opts);
+//
+//   while ((c = cli.parse(argc, argv, &longindex, &state)) != -1) ...
+//
+// longopts is not terminated by an all-zero entry. Exact names cost one
+// hash and one comparison; other names are resolved as abbreviations by
+// binary search over the sorted names, just as ambiguous as with
+// getopt_long().
+template <std::size_t N>
+class schema {
+ public:
+  constexpr schema(const char* optstring, const option (&longopts)[N])
+    : optstring_(optstring), longopts_{}, shortopts_{}, sorted_{}, slots_{} {
+    for (std::size_t i = 0; i < N; ++i) {
+      const option& o = longopts[i];
+      if (o.name == nullptr || o.name[0] == '\0')
+        throw std::logic_error("getopt_port::schema: option without a name");
+      if (std::string_view(o.name).find('=') != std::string_view::npos)
+        throw std::logic_error("getopt_port::schema: '=' in option name");
+      if (o.has_arg != no_argument && o.has_arg != required_argument &&
+          o.has_arg != optional_argument)
+        throw std::logic_error("getopt_port::schema: invalid has_arg");
+      longopts_[i] = o;
+    }
+    longopts_[N] = option{nullptr, 0, nullptr, 0};
+
+    // As getopt_compile(), each character is declared by its first
+    // occurrence, after any '+' or '-' for the ordering.
+    const char* c = optstring;
+    if (*c == '+' || *c == '-')
+      ++c;
+    for (; *c; ++c) {
+      unsigned char& entry = shortopts_[(unsigned char)*c];
+      if (entry != 0 && *c != ':')
+        throw std::logic_error("getopt_port::schema: duplicate short option");
+      if (entry == 0) {
+        entry = c[1] != ':' ? no_argument :
+          c[2] == ':' ? optional_argument : required_argument;
+      }
+    }
+
+    for (std::size_t i = 0; i < table_size; ++i)
+      slots_[i] = -1;
+    for (std::size_t i = 0; i < N; ++i) {
+      std::size_t slot = hash(name(i)) & (table_size - 1);
+      while (slots_[slot] >= 0) {
+        if (name(slots_[slot]) == name(i))
+          throw std::logic_error("getopt_port::schema: duplicate option name");
+        slot = (slot + 1) & (table_size - 1);
+      }
+      slots_[slot] = (int)i;
+    }
+
+    for (std::size_t i = 0; i < N; ++i) {
+      std::size_t j = i;
+      for (; j > 0 && name(i) < name(sorted_[j - 1]); --j)
+        sorted_[j] = sorted_[j - 1];
+      sorted_[j] = (int)i;
+    }
+  }
+
+  // Returns the index of the option named exactly `key`, or -1.
+  constexpr int find(std::string_view key) const {
+    for (std::size_t slot = hash(key) & (table_size - 1);;
+         slot = (slot + 1) & (table_size - 1)) {
+      if (slots_[slot] < 0 || name(slots_[slot]) == key)
+        return slots_[slot];
+    }
+  }
+
+  // The tables in the form getopt_resolved_r() takes. The resolver refers to
+  // this schema, and must not outlive it.
+  getopt_resolver resolver() const {
+    return getopt_resolver{optstring_, longopts_, shortopts_, &lookup, this};
+  }
+
+  int parse(int argc, const char** argv, int* longindex,
+            getopt_state* state) const {
+    getopt_resolver r = resolver();
+    return getopt_resolved_r(argc, argv, &r, longindex, state);
+  }
+
+  const option* longopts() const {
+    return longopts_;
+  }
+
+ private:
+  // A power of two, at most half full, so that probing always ends.
+  static constexpr std::size_t table_size = [] {
+    std::size_t size = 2;
+    while (size < 2 * N)
+      size *= 2;
+    return size;
+  }();
+
+  static constexpr std::size_t hash(std::string_view name) {
+    // FNV-1a
+    std::size_t h = 2166136261u;
+    for (char c : name)
+      h = (h ^ (unsigned char)c) * 16777619u;
+    return h ^ (h >> 15);
+  }
+
+  constexpr std::string_view name(int index) const {
+    return std::string_view(longopts_[index].name);
+  }
+
+  static int lookup(const void* context, const char* name,
+                    std::size_t length, int* num_matches) {
+    const schema& s = *static_cast<const schema*>(context);
+    std::string_view prefix(name, length);
+    std::size_t lo = 0;
+    std::size_t hi = N;
+    std::size_t end = 0;
+    int exact = s.find(prefix);
+
+    if (exact >= 0) {
+      *num_matches = 1;
+      return exact;
+    }
+
+    while (lo < hi) {
+      std::size_t mid = lo + (hi - lo) / 2;
+      if (s.name(s.sorted_[mid]) < prefix)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    for (end = lo; end < N && s.name(s.sorted_[end]).substr(0, length) ==
+                                  prefix;)
+      ++end;
+
+    *num_matches = (int)(end - lo);
+    return end - lo == 1 ? s.sorted_[lo] : -1;
+  }
+
+  const char* optstring_;
+  option longopts_[N + 1];
+  unsigned char shortopts_[256];
+  int sorted_[N];
+  int slots_[table_size];
+};
+
+// A fixed set of keywords for GETOPT_TYPE_ENUM values. Declared constexpr,
+// the constructor builds a minimal perfect hash of the names during
+// compilation, and duplicate names fail to compile:
+//
+//   constexpr const char* mode_names[] = {"fast", "safe", "debug"};
+//   constexpr getopt_port::keywords modes(mode_names);
+//   getopt_value values[] = {
+//     {'m', GETOPT_TYPE_ENUM, &mode, 0, 0, modes.table()}, {0}
+//   };
+//
+// find() costs one hash and one comparison. The table refers to the
+// keywords, which cannot be copied or moved.
+template <std::size_t N>
+class keywords {
+ public:
+  constexpr keywords(const char* const (&names)[N])
+    : names_{}, displacements_{}, slots_{}, seed_(0),
+      table_{names_, &lookup, this} {
+    for (std::size_t i = 0; i < N; ++i) {
+      if (names[i] == nullptr)
+        throw std::logic_error("getopt_port::keywords: null keyword");
+      names_[i] = names[i];
+      for (std::size_t j = 0; j < i; ++j) {
+        if (name(i) == name(j))
+          throw std::logic_error("getopt_port::keywords: duplicate keyword");
+      }
+    }
+    names_[N] = nullptr;
+
+    while (!place())
+      ++seed_;
+  }
+
+  keywords(const keywords&) = delete;
+  keywords& operator=(const keywords&) = delete;
+
+  // Returns the index of `key` among the keywords, or -1.
+  constexpr int find(std::string_view key) const {
+    if (N == 0)
+      return -1;
+
+    std::uint64_t h = hash(key, seed_);
+    int index = slots_[slot(h, displacements_[bucket(h)])];
+    return name(index) == key ? index : -1;
+  }
+
+  // The keywords in the form getopt_value takes.
+  constexpr const getopt_keywords* table() const {
+    return &table_;
+  }
+
+ private:
+  static constexpr std::size_t num_buckets = N / 4 + 1;
+
+  // FNV-1a from a seeded offset basis; the low half picks the bucket and
+  // the high half the slot, as in getopt_keywords_compile().
+  static constexpr std::uint64_t hash(std::string_view key,
+                                      std::uint32_t seed) {
+    std::uint64_t h = 14695981039346656037ull ^ seed;
+    for (char c : key)
+      h = (h ^ (unsigned char)c) * 1099511628211ull;
+    return h;
+  }
+
+  static constexpr std::size_t bucket(std::uint64_t h) {
+    return (std::uint32_t)h % num_buckets;
+  }
+
+  static constexpr std::size_t slot(std::uint64_t h,
+                                    std::uint32_t displacement) {
+    std::uint32_t x = (std::uint32_t)(h >> 32) + displacement * 0x9e3779b9u;
+    x = (x ^ (x >> 16)) * 0x85ebca6bu;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+    return (x ^ (x >> 16)) % (N == 0 ? 1 : N);
+  }
+
+  constexpr std::string_view name(std::size_t index) const {
+    return std::string_view(names_[index]);
+  }
+
+  // Places the buckets, largest first, each with the first displacement
+  // that moves all of its keywords to free slots. Returns false if the
+  // seed does not work out.
+  constexpr bool place() {
+    std::array<std::uint64_t, N + 1> hashes{};
+    std::array<std::size_t, num_buckets> sizes{};
+    std::array<std::size_t, num_buckets> order{};
+
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = hash(name(i), seed_);
+      ++sizes[bucket(hashes[i])];
+    }
+    for (std::size_t b = 0; b < num_buckets; ++b) {
+      std::size_t j = b;
+      for (; j > 0 && sizes[order[j - 1]] < sizes[b]; --j)
+        order[j] = order[j - 1];
+      order[j] = b;
+    }
+
+    for (std::size_t i = 0; i < N; ++i)
+      slots_[i] = -1;
+    for (std::size_t b : order) {
+      std::uint32_t d = 0;
+      for (;; ++d) {
+        if (d > 64 * N + 1024)
+          return false;
+
+        // Claim the slots of the bucket, backing out on a collision.
+        std::size_t claimed = 0;
+        bool collided = false;
+        for (std::size_t i = 0; i < N && !collided; ++i) {
+          if (bucket(hashes[i]) != b)
+            continue;
+          std::size_t s = slot(hashes[i], d);
+          if (slots_[s] >= 0) {
+            collided = true;
+          } else {
+            slots_[s] = (int)i;
+            ++claimed;
+          }
+        }
+        if (!collided)
+          break;
+        for (std::size_t i = 0; i < N && claimed > 0; ++i) {
+          std::size_t s = slot(hashes[i], d);
+          if (bucket(hashes[i]) == b && slots_[s] == (int)i) {
+            slots_[s] = -1;
+            --claimed;
+          }
+        }
+      }
+      displacements_[b] = d;
+    }
+    return true;
+  }
+
+  static int lookup(const void* context, const char* s, std::size_t length) {
+    return static_cast<const keywords*>(context)->find(
+      std::string_view(s, length));
+  }
+
+  const char* names_[N + 1];
+  std::uint32_t displacements_[num_buckets];
+  int slots_[N == 0 ? 1 : N];
+  std::uint32_t seed_;
+  getopt_keywords table_;
+};
+
+// The options and operands of a whole command line, as found by
+// getopt_parse(). Records and operand indices are kept in inline arrays
+// while they fit, so typical command lines are parsed without allocating.
+// Otherwise parse() allocates one block of exactly the size needed from
+// `arena`, which is reused by later parses that fit in it. Values are views
+// into argv, which must outlive the result.
+template <std::size_t InlineRecords = 16, std::size_t InlineOperands = 16>
+class parse_result {
+ public:
+  explicit parse_result(
+      std::pmr::memory_resource* arena = std::pmr::get_default_resource())
+    : arena_(arena) {
+  }
+
+  ~parse_result() {
+    if (block_ != nullptr)
+      arena_->deallocate(block_, block_size_, alignof(getopt_record));
+  }
+
+  parse_result(const parse_result&) = delete;
+  parse_result& operator=(const parse_result&) = delete;
+
+  void parse(int argc, const char* const* argv,
+             const getopt_resolver& resolver) {
+    run(argv, [&](getopt_result* result) {
+      return getopt_parse_resolved(argc, argv, &resolver, result);
+    });
+  }
+
+  void parse(int argc, const char* const* argv, const getopt_spec* spec) {
+    run(argv, [&](getopt_result* result) {
+      return getopt_parse(argc, argv, spec, result);
+    });
+  }
+
+  template <std::size_t N>
+  void parse(int argc, const char* const* argv, const schema<N>& s) {
+    parse(argc, argv, s.resolver());
+  }
+
+  // The options, in the order given.
+  std::size_t size() const {
+    return (std::size_t)result_.num_records;
+  }
+
+  const getopt_record& operator[](std::size_t i) const {
+    return result_.records[i];
+  }
+
+  const getopt_record* begin() const {
+    return result_.records;
+  }
+
+  const getopt_record* end() const {
+    return result_.records + result_.num_records;
+  }
+
+  // The last occurrence of the option with the given id, or nullptr.
+  const getopt_record* find(int id) const {
+    for (const getopt_record* r = end(); r != begin();) {
+      if ((--r)->id == id)
+        return r;
+    }
+    return nullptr;
+  }
+
+  std::size_t count(int id) const {
+    std::size_t n = 0;
+    for (const getopt_record& r : *this)
+      n += r.id == id;
+    return n;
+  }
+
+  // The value of the last occurrence of the option, with nullptr data if
+  // it is absent or has no value.
+  std::string_view value(int id) const {
+    const getopt_record* r = find(id);
+    return r != nullptr ? option_value(*r) : std::string_view();
+  }
+
+  std::size_t num_operands() const {
+    return (std::size_t)result_.num_operands;
+  }
+
+  std::string_view operand(std::size_t i) const {
+    return std::string_view(argv_[result_.operands[i]]);
+  }
+
+  // argv index of the i:th operand.
+  int operand_index(std::size_t i) const {
+    return result_.operands[i];
+  }
+
+ private:
+  // Parses into the inline arrays and the block, if there is one. If that
+  // is not enough room, parses again into a new block.
+  template <class Parse>
+  void run(const char* const* argv, Parse parse_into) {
+    argv_ = argv;
+    result_ = getopt_result{inline_records_.data(), (int)InlineRecords, 0,
+                            inline_operands_.data(), (int)InlineOperands, 0};
+    if (block_ != nullptr)
+      use_block();
+
+    if (parse_into(&result_) != 0) {
+      allocate(result_.num_records, result_.num_operands);
+      parse_into(&result_);
+    }
+  }
+
+  // Replaces the block, if any, with one for exactly the records and
+  // operands that do not fit inline, laid out records first.
+  void allocate(int num_records, int num_operands) {
+    if (block_ != nullptr)
+      arena_->deallocate(block_, block_size_, alignof(getopt_record));
+
+    max_records_ = num_records > (int)InlineRecords ? num_records : 0;
+    max_operands_ = num_operands > (int)InlineOperands ? num_operands : 0;
+    block_size_ = max_records_ * sizeof(getopt_record) +
+      max_operands_ * sizeof(int);
+    block_ = nullptr;  // in case allocate() throws
+    block_ = arena_->allocate(block_size_, alignof(getopt_record));
+    use_block();
+  }
+
+  // Uses the block for whichever of records and operands it has more
+  // room for than the inline arrays.
+  void use_block() {
+    getopt_record* records = static_cast<getopt_record*>(block_);
+    int* operands = reinterpret_cast<int*>(records + max_records_);
+
+    if (max_records_ > result_.max_records) {
+      result_.records = records;
+      result_.max_records = max_records_;
+    }
+    if (max_operands_ > result_.max_operands) {
+      result_.operands = operands;
+      result_.max_operands = max_operands_;
+    }
+  }
+
+  std::pmr::memory_resource* arena_;
+  const char* const* argv_ = nullptr;
+  getopt_result result_ = {};
+  void* block_ = nullptr;
+  std::size_t block_size_ = 0;
+  int max_records_ = 0;
+  int max_operands_ = 0;
+  std::array<getopt_record, InlineRecords> inline_records_;
+  std::array<int, InlineOperands> inline_operands_;
+};
+
+}  // namespace getopt_port
+
+#endif  // INCLUDED_GETOPT_PORT_HPP
@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#ifndef INCLUDED_GETOPT_PORT_BASIC_HPP
+#define INCLUDED_GETOPT_PORT_BASIC_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "getopt.h"
+
+// getopt_r() and getopt_long_r() for argv of any character type: wchar_t
+// as passed to wmain() on Windows, char16_t, char32_t, or char8_t. Options
+// and arguments are parsed in place, and optarg points into argv, so
+// nothing is converted or copied. Option characters and names are matched
+// code unit by code unit, and only the ASCII '-', ':', '+' and '=' are
+// special.
+//
+// The parser is getopt_core.inc, the same code getopt.c runs for char,
+// instantiated here as templates, so the two behave alike by construction,
+// including permutation, '+' and '-' ordering and abbreviations. Long
+// options are looked up by scanning the table, and errors are reported in
+// the state's error member; compiled specs, typed values and the diagnose
+// callback are only available for char, through the C API.
+
+namespace getopt_port {
+
+template <class CharT>
+struct basic_option {
+  const CharT* name;
+  int has_arg;
+  int* flag;
+  int val;
+};
+
+// Like getopt_state. A default-constructed state is ready for use, and
+// setting optind to 1 or less restarts the scan.
+template <class CharT>
+struct basic_getopt_state {
+  const CharT* optarg = nullptr;
+  int optind = 0;
+  int optopt = 0;
+  int flags = 0;
+
+  // GETOPT_ERROR_* for the option '?' or ':' was last returned for, or 0.
+  int error = 0;
+
+  // The last option as written, without its dashes or "=value", and its
+  // option-argument, which is empty with a null data() if there is none.
+  std::basic_string_view<CharT> optname;
+  std::basic_string_view<CharT> optvalue;
+
+  // private
+  const CharT* optcursor = nullptr;
+  int first_nonopt = 0;
+  int last_nonopt = 0;
+  int segment = 0;
+  int num_segments = 0;
+  int segments[GETOPT_MAX_SEGMENTS][2] = {};
+};
+
+namespace detail {
+
+// What getopt_core.inc expects of the including file; see there. The
+// character arguments of set_optarg() and set_optname() are not deduced,
+// so that the core can pass NULL for them.
+template <class T>
+struct non_deduced {
+  using type = T;
+};
+
+template <class CharT>
+void set_optarg(basic_getopt_state<CharT>* state,
+                const typename non_deduced<CharT>::type* arg,
+                std::size_t length) {
+  state->optarg = arg;
+  state->optvalue = arg != nullptr ?
+    std::basic_string_view<CharT>(arg, length) :
+    std::basic_string_view<CharT>();
+}
+
+template <class CharT>
+void set_optname(basic_getopt_state<CharT>* state,
+                 const typename non_deduced<CharT>::type* name,
+                 std::size_t length) {
+  state->optname = name != nullptr ?
+    std::basic_string_view<CharT>(name, length) :
+    std::basic_string_view<CharT>();
+}
+
+template <class CharT>
+void clear_option(basic_getopt_state<CharT>* state) {
+  set_optarg(state, nullptr, 0);
+  set_optname(state, nullptr, 0);
+  state->optopt = 0;
+  state->error = 0;
+}
+
+// The length of s, and in *equals the offset of its first '=', or the
+// length if there is none.
+template <class CharT>
+std::size_t scan_argument(const CharT* s, std::size_t* equals) {
+  const CharT* p = s;
+
+  while (*p != '\0' && *p != '=')
+    ++p;
+  *equals = static_cast<std::size_t>(p - s);
+  while (*p != '\0')
+    ++p;
+  return static_cast<std::size_t>(p - s);
+}
+
+// Typed values are only converted for char.
+template <class CharT>
+int convert_value(const CharT**, int, int, int id,
+                  basic_getopt_state<CharT>*) {
+  return id;
+}
+
+template <class CharT>
+void report(const CharT**, int, int error, int, const CharT*, std::size_t,
+            int, basic_getopt_state<CharT>* state) {
+  state->error = error;
+}
+
+template <class CharT>
+void report_unmatched(const CharT**, int, const basic_option<CharT>*,
+                      const CharT*, std::size_t, int num_matches,
+                      basic_getopt_state<CharT>* state) {
+  state->error = num_matches == 0 ? GETOPT_ERROR_UNKNOWN_OPTION :
+    GETOPT_ERROR_AMBIGUOUS_OPTION;
+}
+
+// Resolvers are only compiled for char, and none is passed here.
+template <class CharT>
+int resolve_long(const getopt_resolver*, const CharT*, std::size_t,
+                 int* num_matches, unsigned long*) {
+  *num_matches = 0;
+  return -1;
+}
+
+#define GETOPT_CHAR CharT
+#define GETOPT_STATE basic_getopt_state<CharT>
+#define GETOPT_OPTION basic_option<CharT>
+#define GETOPT_CORE template <class CharT>
+#define GETOPT_LENGTH std::char_traits<CharT>::length
+#define GETOPT_COUNT(statement)
+
+#include "getopt_core.inc"
+
+#undef GETOPT_CHAR
+#undef GETOPT_STATE
+#undef GETOPT_OPTION
+#undef GETOPT_CORE
+#undef GETOPT_LENGTH
+#undef GETOPT_COUNT
+
+}  // namespace detail
+
+template <class CharT>
+int basic_getopt_r(int argc, const CharT** argv, const CharT* optstring,
+                   basic_getopt_state<CharT>& state) {
+  return detail::parse_short(argc, argv, optstring,
+                             static_cast<const getopt_resolver*>(nullptr),
+                             &state);
+}
+
+template <class CharT>
+int basic_getopt_long_r(int argc, const CharT** argv, const CharT* optstring,
+                        const basic_option<CharT>* longopts, int* longindex,
+                        basic_getopt_state<CharT>& state) {
+  return detail::parse_long(argc, argv, optstring, longopts,
+                            static_cast<const getopt_resolver*>(nullptr),
+                            longindex, &state);
+}
+
+using woption = basic_option<wchar_t>;
+using wgetopt_state = basic_getopt_state<wchar_t>;
+
+}  // namespace getopt_port
+
+#endif  // INCLUDED_GETOPT_PORT_BASIC_HPP
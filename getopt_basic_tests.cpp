@@ -0,0 +1,200 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt_basic.hpp"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <string>
+#include <vector>
+
+using getopt_port::basic_getopt_long_r;
+using getopt_port::basic_getopt_r;
+using getopt_port::basic_getopt_state;
+using getopt_port::basic_option;
+
+namespace {
+
+const getopt_port::woption wide_opts[] = {
+  {L"verbose", no_argument, NULL, 'v'},
+  {L"output", required_argument, NULL, 'o'},
+  {L"level", optional_argument, NULL, 'l'},
+  {0, 0, 0, 0}
+};
+
+// Widens each byte on its own, as the narrow parser sees it.
+std::wstring widen(const std::string& s) {
+  std::wstring wide;
+  for (size_t i = 0; i < s.size(); ++i)
+    wide += (wchar_t)(signed char)s[i];
+  return wide;
+}
+
+// Parses args with getopt_long_r() and with basic_getopt_long_r() on the
+// widened args, which must agree call by call and permute alike.
+void check_against_narrow(const std::vector<std::string>& args,
+                          const char* optstring) {
+  const option narrow_opts[] = {
+    {"verbose", no_argument, NULL, 'v'},
+    {"output", required_argument, NULL, 'o'},
+    {"level", optional_argument, NULL, 'l'},
+    {"lever", no_argument, NULL, 'r'},
+    {0, 0, 0, 0}
+  };
+  const basic_option<wchar_t> opts[] = {
+    {L"verbose", no_argument, NULL, 'v'},
+    {L"output", required_argument, NULL, 'o'},
+    {L"level", optional_argument, NULL, 'l'},
+    {L"lever", no_argument, NULL, 'r'},
+    {0, 0, 0, 0}
+  };
+  std::vector<std::wstring> wide_args;
+  std::vector<const char*> argv;
+  std::vector<const wchar_t*> wide_argv;
+  std::wstring wide_optstring = widen(optstring);
+  getopt_state state = {0};
+  basic_getopt_state<wchar_t> wide_state;
+  int argc = (int)args.size();
+
+  for (size_t i = 0; i < args.size(); ++i)
+    wide_args.push_back(widen(args[i]));
+  for (size_t i = 0; i < args.size(); ++i) {
+    argv.push_back(args[i].c_str());
+    wide_argv.push_back(wide_args[i].c_str());
+  }
+
+  for (;;) {
+    int longindex = -1;
+    int wide_longindex = -1;
+    int c = getopt_long_r(argc, &argv[0], optstring, narrow_opts, &longindex,
+      &state);
+    int w = basic_getopt_long_r(argc, &wide_argv[0], wide_optstring.c_str(),
+      opts, &wide_longindex, wide_state);
+
+    assert_equal(c, w);
+    assert_equal(longindex, wide_longindex);
+    assert_equal(state.optind, wide_state.optind);
+    assert_equal(state.optopt, wide_state.optopt);
+    assert_equal(state.optarg == NULL, wide_state.optarg == NULL);
+    if (state.optarg != NULL)
+      assert_equal(true, widen(state.optarg) == wide_state.optarg);
+    if (c == -1)
+      break;
+  }
+
+  for (int i = 0; i < argc; ++i)
+    assert_equal(true, widen(argv[i]) == wide_argv[i]);
+}
+
+}
+
+TEST_F(getopt_fixture, test_basic_getopt_wide) {
+  const wchar_t* argv[] = {L"foo.exe", L"in", L"-vo", L"out", L"--lev=2",
+                           L"--verbose=x", L"-é", L"--", L"-v"};
+  basic_getopt_state<wchar_t> state;
+  int longindex = -1;
+
+  assert_equal('v', basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, NULL, state));
+  assert_equal('o', basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, NULL, state));
+  assert_equal(true, state.optarg == argv[3]);
+
+  // Abbreviations and arguments after '=', pointing into argv.
+  assert_equal('l', basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, &longindex, state));
+  assert_equal(2, longindex);
+  assert_equal(true, state.optname == L"lev");
+  assert_equal(true, state.optarg == argv[4] + 6);
+
+  assert_equal('?', basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, NULL, state));
+  assert_equal(GETOPT_ERROR_UNEXPECTED_ARGUMENT, state.error);
+
+  // Any code unit can be an option character.
+  assert_equal('?', basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, NULL, state));
+  assert_equal(0xe9, state.optopt);
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, state.error);
+  assert_equal(-1, basic_getopt_long_r(count(argv), argv, L"vo:l::",
+    wide_opts, NULL, state));
+
+  // Operands were moved after the options, in order.
+  assert_equal(7, state.optind);
+  assert_equal(true, std::wstring(argv[7]) == L"in");
+  assert_equal(true, std::wstring(argv[8]) == L"-v");
+}
+
+TEST_F(getopt_fixture, test_basic_getopt_utf16) {
+  const char16_t* argv[] = {u"foo", u"-a中", u"-b", u"--", u"x"};
+  basic_getopt_state<char16_t> state;
+
+  assert_equal('a', basic_getopt_r(count(argv), argv, u"+a:b", state));
+  assert_equal(true, std::u16string(state.optarg) == u"中");
+  assert_equal('b', basic_getopt_r(count(argv), argv, u"+a:b", state));
+  assert_equal(-1, basic_getopt_r(count(argv), argv, u"+a:b", state));
+  assert_equal(4, state.optind);
+
+  // Missing arguments, with and without a leading ':'.
+  const char16_t* missing[] = {u"foo", u"-a"};
+  state = basic_getopt_state<char16_t>();
+  assert_equal(':', basic_getopt_r(count(missing), missing, u":a:", state));
+  assert_equal(GETOPT_ERROR_MISSING_ARGUMENT, state.error);
+  state = basic_getopt_state<char16_t>();
+  assert_equal('?', basic_getopt_r(count(missing), missing, u"a:", state));
+}
+
+#if defined(__cpp_char8_t)
+TEST_F(getopt_fixture, test_basic_getopt_utf8) {
+  const char8_t* argv[] = {u8"foo", u8"--name=été"};
+  const basic_option<char8_t> opts[] = {
+    {u8"name", required_argument, NULL, 'n'},
+    {0, 0, 0, 0}
+  };
+  basic_getopt_state<char8_t> state;
+
+  assert_equal('n', basic_getopt_long_r(count(argv), argv, u8"", opts, NULL,
+    state));
+  assert_equal(true, std::u8string(state.optarg) == u8"été");
+}
+#endif
+
+TEST_F(getopt_fixture, test_basic_getopt_matches_narrow) {
+  const char* optstrings[] = {"vo:l::", "+vo:", "-:vo:l::", ":a\xe9"};
+  std::vector<std::vector<std::string> > cases = {
+    {"foo", "a", "-v", "b", "c", "--out", "x", "d", "-ol", "--", "-v"},
+    {"foo", "--le", "--level=3", "--lev", "e", "--leve", "-", "f"},
+    {"foo", "-\xe9\x61", "--verbose=1", "--zzz", "g", "-l7", "--output"},
+    {"foo", "h", "i", "-v", "j", "-v", "k", "l", "-v", "m", "-o"},
+  };
+
+  for (size_t i = 0; i < count(optstrings); ++i) {
+    for (size_t j = 0; j < cases.size(); ++j)
+      check_against_narrow(cases[j], optstrings[i]);
+  }
+}
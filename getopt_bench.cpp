@@ -0,0 +1,350 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+// Micro-benchmarks for the parsers. Every result is printed as one
+// tab-separated line,
+//
+//   scenario <TAB> argc <TAB> ns/arg <TAB> allocs/parse
+//
+// after a header line, so runs can be diffed across versions. Allocations
+// are counted through the GETOPT_MALLOC hook and operator new while the
+// parse is timed.
+//
+// Usage: bench_getopt_port [-r repetitions] [-s scenario-substring]
+
+#include "getopt.h"
+#include "getopt_bulk.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::atomic<unsigned long> allocations(0);
+
+extern "C" void* getopt_bench_malloc(size_t size) {
+  ++allocations;
+  return malloc(size);
+}
+
+extern "C" void getopt_bench_free(void* ptr) {
+  free(ptr);
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* ptr = malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+namespace {
+
+const int num_longopts = 256;
+
+// Option names are fixed-width, so "--option-NNN" is an unambiguous
+// abbreviation of "--option-NNN-value".
+struct longopt_table {
+  std::vector<std::string> names;
+  std::vector<option> options;
+
+  explicit longopt_table(int has_arg) {
+    char buf[32];
+    for (int i = 0; i < num_longopts; ++i) {
+      sprintf(buf, "option-%03d-value", i);
+      names.push_back(buf);
+    }
+    for (int i = 0; i < num_longopts; ++i) {
+      option o = {names[i].c_str(), has_arg, NULL, 1000 + i};
+      options.push_back(o);
+    }
+    option end = {0, 0, 0, 0};
+    options.push_back(end);
+  }
+};
+
+struct workload {
+  std::vector<std::string> storage;
+  std::vector<const char*> argv;
+
+  void finish() {
+    argv.assign(1, "bench");
+    for (size_t i = 0; i < storage.size(); ++i)
+      argv.push_back(storage[i].c_str());
+  }
+};
+
+// Picks option indices in a fixed pseudo-random order, so that lookups
+// do not always hit the same entry.
+int pick(int i) {
+  return (int)((i * 2654435761u) % num_longopts);
+}
+
+void make_nothing(workload& w, int) {
+  w.storage.clear();
+  w.finish();
+}
+
+void make_short_clusters(workload& w, int size) {
+  w.storage.assign(size - 1, "-abcdefgh");
+  w.finish();
+}
+
+void make_long_names(workload& w, int size, const char* format) {
+  char buf[64];
+  w.storage.clear();
+  for (int i = 1; i < size; ++i) {
+    sprintf(buf, format, pick(i));
+    w.storage.push_back(buf);
+  }
+  w.finish();
+}
+
+void make_long_exact(workload& w, int size) {
+  make_long_names(w, size, "--option-%03d-value");
+}
+
+void make_long_abbrev(workload& w, int size) {
+  make_long_names(w, size, "--option-%03d");
+}
+
+// Two characters swapped, which no option starts with.
+void make_long_typos(workload& w, int size) {
+  make_long_names(w, size, "--otpion-%03d-value");
+}
+
+void make_name_value(workload& w, int size) {
+  make_long_names(w, size, "--option-%03d-value=some/path/to/a/file");
+}
+
+// {"bench", <operands...>, -a, -b, ...} with `leading` operands before
+// the first option, then one option every `stride` elements.
+void make_operands(workload& w, int size, int leading, int stride) {
+  w.storage.clear();
+  for (int i = 1; i < size; ++i) {
+    if (i > leading && (i - leading) % stride == 0)
+      w.storage.push_back((i & 1) ? "-a" : "-b");
+    else
+      w.storage.push_back("operand");
+  }
+  w.finish();
+}
+
+void make_leading_operands(workload& w, int size) {
+  make_operands(w, size, size / 2, 1);
+}
+
+void make_every_64th_flag(workload& w, int size) {
+  make_operands(w, size, 0, 64);
+}
+
+void make_every_8th_flag(workload& w, int size) {
+  make_operands(w, size, 0, 8);
+}
+
+const longopt_table flag_table(no_argument);
+const longopt_table value_table(required_argument);
+getopt_spec* flag_spec;
+getopt_spec* value_spec;
+
+void parse_short(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_r(argc, argv, "abcdefgh", &state) != -1) {
+  }
+}
+
+void parse_long_flags(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_long_r(argc, argv, "", &flag_table.options[0], NULL,
+                       &state) != -1) {
+  }
+}
+
+void parse_compiled_flags(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_compiled_r(argc, argv, flag_spec, NULL, &state) != -1) {
+  }
+}
+
+void parse_long_values(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_long_r(argc, argv, "", &value_table.options[0], NULL,
+                       &state) != -1) {
+  }
+}
+
+void parse_compiled_values(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_compiled_r(argc, argv, value_spec, NULL, &state) != -1) {
+  }
+}
+
+void ignore_error(void*, const getopt_diagnostic*) {
+}
+
+// With a diagnose callback, so that every typo is given a suggestion.
+void parse_compiled_typos(int argc, const char** argv) {
+  getopt_state state = {0};
+  state.diagnose = ignore_error;
+  while (getopt_compiled_r(argc, argv, flag_spec, NULL, &state) != -1) {
+  }
+}
+
+void parse_permute(int argc, const char** argv) {
+  getopt_state state = {0};
+  while (getopt_r(argc, argv, "ab", &state) != -1) {
+  }
+}
+
+// Parses argv as independent command lines of 16 elements each.
+void parse_bulk(int argc, const char** argv, unsigned num_threads) {
+  std::vector<getopt_port::command_line> lines;
+  for (int i = 0; i + 16 <= argc; i += 16)
+    lines.push_back(getopt_port::command_line{16, argv + i});
+  getopt_port::bulk_parse(lines.data(), lines.size(), flag_spec, num_threads);
+}
+
+void parse_bulk_one_thread(int argc, const char** argv) {
+  parse_bulk(argc, argv, 1);
+}
+
+void parse_bulk_all_threads(int argc, const char** argv) {
+  parse_bulk(argc, argv, 0);
+}
+
+void compile_longopts(int, const char**) {
+  getopt_spec_free(getopt_compile("", &flag_table.options[0]));
+}
+
+struct scenario {
+  const char* name;
+  void (*make)(workload&, int);
+  void (*parse)(int, const char**);
+  int fixed_size;  // if nonzero, the only size to run, instead of argc
+};
+
+const scenario scenarios[] = {
+  {"short_clusters", make_short_clusters, parse_short, 0},
+  {"long_exact", make_long_exact, parse_long_flags, 0},
+  {"long_exact_compiled", make_long_exact, parse_compiled_flags, 0},
+  {"long_abbrev", make_long_abbrev, parse_long_flags, 0},
+  {"long_abbrev_compiled", make_long_abbrev, parse_compiled_flags, 0},
+  {"long_typos_compiled", make_long_typos, parse_compiled_typos, 0},
+  {"long_name_value", make_name_value, parse_long_values, 0},
+  {"long_name_value_compiled", make_name_value, parse_compiled_values, 0},
+  {"permute_leading_operands", make_leading_operands, parse_permute, 0},
+  {"permute_every_64th_flag", make_every_64th_flag, parse_permute, 0},
+  {"permute_every_8th_flag", make_every_8th_flag, parse_permute, 0},
+  {"bulk_one_thread", make_long_exact, parse_bulk_one_thread, 0},
+  {"bulk_all_threads", make_long_exact, parse_bulk_all_threads, 0},
+  // Measured per option in the table rather than per argv element.
+  {"compile_longopts", make_nothing, compile_longopts, num_longopts},
+};
+
+void run(const scenario& s, int size, int repetitions) {
+  workload w;
+  s.make(w, size);
+
+  std::vector<const char*> argv(w.argv.size() + 1);
+  std::chrono::steady_clock::duration total(0);
+  unsigned long allocs = 0;
+
+  for (int r = 0; r < repetitions; ++r) {
+    // Permutation writes to argv, so every repetition starts afresh.
+    for (size_t i = 0; i < w.argv.size(); ++i)
+      argv[i] = w.argv[i];
+
+    unsigned long before = allocations;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    s.parse((int)w.argv.size(), &argv[0]);
+    total += std::chrono::steady_clock::now() - start;
+    allocs += allocations - before;
+  }
+
+  double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      total).count();
+  printf("%s\t%d\t%.2f\t%.2f\n", s.name, size, ns / repetitions / size,
+         (double)allocs / repetitions);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int repetitions = 20;
+  const char* filter = "";
+  int c;
+
+  while ((c = getopt(argc, (const char**)argv, "r:s:")) != -1) {
+    switch (c) {
+    case 'r':
+      repetitions = atoi(optarg);
+      break;
+    case 's':
+      filter = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-r repetitions] [-s scenario]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (repetitions < 1)
+    repetitions = 1;
+
+  flag_spec = getopt_compile("", &flag_table.options[0]);
+  value_spec = getopt_compile("", &value_table.options[0]);
+
+  printf("scenario\targc\tns_per_arg\tallocs_per_parse\n");
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+    if (strstr(scenarios[i].name, filter) == NULL)
+      continue;
+    if (scenarios[i].fixed_size != 0) {
+      run(scenarios[i], scenarios[i].fixed_size, repetitions);
+      continue;
+    }
+    for (int size = 1000; size <= 64000; size *= 4)
+      run(scenarios[i], size, repetitions);
+  }
+
+  getopt_spec_free(value_spec);
+  getopt_spec_free(flag_spec);
+  return 0;
+}
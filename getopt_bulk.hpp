@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#ifndef INCLUDED_GETOPT_PORT_BULK_HPP
+#define INCLUDED_GETOPT_PORT_BULK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "getopt.h"
+
+namespace getopt_port {
+
+// One of the command lines given to bulk_parse().
+struct command_line {
+  int argc;
+  const char* const* argv;
+};
+
+// What bulk_parse() found in one command line. Its options and the argv
+// indices of its operands are ranges of bulk_result::records() and
+// bulk_result::operands(), in the order given.
+struct bulk_entry {
+  std::size_t first_record;
+  std::size_t num_records;
+  std::size_t first_operand;
+  std::size_t num_operands;
+  int error;        // GETOPT_ERROR_* of the first erroneous option, or 0
+  int error_index;  // argv index of that option
+  // For an unknown long option, the name it was likely meant as, or NULL.
+  const char* suggestion;
+};
+
+class bulk_result {
+ public:
+  std::size_t size() const {
+    return entries_.size();
+  }
+
+  const bulk_entry& operator[](std::size_t i) const {
+    return entries_[i];
+  }
+
+  // The first option of command line i, followed by the rest of them.
+  const getopt_record* records(std::size_t i) const {
+    return records_.data() + entries_[i].first_record;
+  }
+
+  const int* operands(std::size_t i) const {
+    return operands_.data() + entries_[i].first_operand;
+  }
+
+  // The number of command lines with an error.
+  std::size_t num_errors() const {
+    return (std::size_t)std::count_if(entries_.begin(), entries_.end(),
+      [](const bulk_entry& e) { return e.error != 0; });
+  }
+
+ private:
+  friend bulk_result bulk_parse(const command_line*, std::size_t,
+                                const getopt_resolver&, unsigned);
+
+  std::vector<bulk_entry> entries_;
+  std::vector<getopt_record> records_;
+  std::vector<int> operands_;
+};
+
+namespace detail {
+
+// Runs work(i) for every i in [0, count) on num_threads threads, the
+// calling thread being one of them. Threads claim the next index as they
+// become idle, so uneven work evens out.
+template <class Work>
+void run_parallel(std::size_t count, unsigned num_threads, Work work) {
+  std::atomic<std::size_t> next(0);
+  auto worker = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < count;)
+      work(i);
+  };
+
+  std::vector<std::thread> threads;
+  num_threads = (unsigned)std::min<std::size_t>(num_threads, count);
+  for (unsigned t = 1; t < num_threads; ++t)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& t : threads)
+    t.join();
+}
+
+inline void record_first_error(void* context,
+                               const getopt_diagnostic* diagnostic) {
+  bulk_entry* entry = static_cast<bulk_entry*>(context);
+  if (entry->error == 0) {
+    entry->error = diagnostic->error;
+    entry->error_index = diagnostic->index;
+    entry->suggestion = diagnostic->suggestion;
+  }
+}
+
+// Parses a command line as getopt_parse() would, and appends what it finds.
+inline bulk_entry parse_line(const command_line& line,
+                             const getopt_resolver& resolver,
+                             std::vector<getopt_record>& records,
+                             std::vector<int>& operands) {
+  // argv is not written to in order.
+  const char** argv = const_cast<const char**>(line.argv);
+  bulk_entry entry = {records.size(), 0, operands.size(), 0, 0, 0, NULL};
+  getopt_state state = {};
+  state.optind = 1;
+  state.flags = GETOPT_RETURN_IN_ORDER;
+  state.diagnose = record_first_error;
+  state.diagnose_context = &entry;
+
+  // As in getopt_parse(), a '+' optstring ends the options at the first
+  // operand.
+  const bool require_order = resolver.optstring[0] == '+';
+
+  for (;;) {
+    int index = state.optind;
+    int longindex = -1;
+    int id = getopt_resolved_r(line.argc, argv, &resolver, &longindex,
+                               &state);
+    if (id == -1)
+      break;
+    if (id == 1 && state.optname.data == nullptr) {
+      if (require_order) {
+        --state.optind;
+        break;
+      }
+      operands.push_back(state.optind - 1);
+      continue;
+    }
+    records.push_back(getopt_record{id, longindex, index, state.optvalue.data,
+                                    state.optvalue.length});
+  }
+
+  // Everything after "--" or "-", or the first operand with a '+'
+  // optstring, is an operand.
+  for (int i = state.optind; i < line.argc && argv[i] != nullptr; ++i)
+    operands.push_back(i);
+
+  entry.num_records = records.size() - entry.first_record;
+  entry.num_operands = operands.size() - entry.first_operand;
+  return entry;
+}
+
+}  // namespace detail
+
+// Parses many independent command lines with one shared resolver, such as
+// a getopt_spec or a schema, on num_threads threads, or one per core if it
+// is 0. The lines are handed out in chunks to whichever thread is idle,
+// and each chunk collects its results locally, so threads share nothing
+// but the resolver until the chunks are copied into place, also in
+// parallel. Records refer into the argv arrays, which must outlive the
+// result.
+inline bulk_result bulk_parse(const command_line* lines,
+                              std::size_t num_lines,
+                              const getopt_resolver& resolver,
+                              unsigned num_threads = 0) {
+  struct chunk {
+    std::vector<bulk_entry> entries;
+    std::vector<getopt_record> records;
+    std::vector<int> operands;
+    std::size_t first_record;
+    std::size_t first_operand;
+  };
+  const std::size_t chunk_size = 256;
+  std::vector<chunk> chunks((num_lines + chunk_size - 1) / chunk_size);
+  bulk_result result;
+
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  detail::run_parallel(chunks.size(), num_threads, [&](std::size_t c) {
+    chunk& out = chunks[c];
+    std::size_t end = std::min(num_lines, (c + 1) * chunk_size);
+    out.entries.reserve(end - c * chunk_size);
+    for (std::size_t i = c * chunk_size; i < end; ++i) {
+      out.entries.push_back(detail::parse_line(lines[i], resolver,
+                                               out.records, out.operands));
+    }
+  });
+
+  std::size_t num_records = 0;
+  std::size_t num_operands = 0;
+  for (chunk& c : chunks) {
+    c.first_record = num_records;
+    c.first_operand = num_operands;
+    num_records += c.records.size();
+    num_operands += c.operands.size();
+  }
+  result.entries_.resize(num_lines);
+  result.records_.resize(num_records);
+  result.operands_.resize(num_operands);
+
+  detail::run_parallel(chunks.size(), num_threads, [&](std::size_t c) {
+    chunk& in = chunks[c];
+    bulk_entry* entries = result.entries_.data() + c * chunk_size;
+    for (std::size_t i = 0; i < in.entries.size(); ++i) {
+      entries[i] = in.entries[i];
+      entries[i].first_record += in.first_record;
+      entries[i].first_operand += in.first_operand;
+    }
+    std::copy(in.records.begin(), in.records.end(),
+              result.records_.begin() + in.first_record);
+    std::copy(in.operands.begin(), in.operands.end(),
+              result.operands_.begin() + in.first_operand);
+  });
+
+  return result;
+}
+
+inline bulk_result bulk_parse(const command_line* lines,
+                              std::size_t num_lines, const getopt_spec* spec,
+                              unsigned num_threads = 0) {
+  return bulk_parse(lines, num_lines, *getopt_spec_resolver(spec),
+                    num_threads);
+}
+
+}  // namespace getopt_port
+
+#endif  // INCLUDED_GETOPT_PORT_BULK_HPP
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt_bulk.hpp"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+option bulk_opts[] = {
+  {"verbose", no_argument, NULL, 'v'},
+  {"output", required_argument, NULL, 'o'},
+  {0, 0, 0, 0}
+};
+
+// Command lines of a few kinds, some of them erroneous, stored as strings.
+struct job_queue {
+  std::vector<std::vector<std::string>> args;
+  std::vector<std::vector<const char*>> argvs;
+  std::vector<getopt_port::command_line> lines;
+
+  explicit job_queue(int count) : args(count), argvs(count) {
+    for (int i = 0; i < count; ++i) {
+      std::vector<std::string>& a = args[i];
+      a.push_back("job");
+      a.push_back("in" + std::to_string(i));
+      switch (i % 4) {
+      case 0:
+        a.push_back("-vo");
+        a.push_back("out" + std::to_string(i));
+        break;
+      case 1:
+        a.push_back("--output=x");
+        a.push_back("--");
+        a.push_back("-v");
+        break;
+      case 2:
+        a.push_back("-q");
+        a.push_back("--verbose=1");
+        break;
+      case 3:
+        a.push_back("--verb");
+        a.push_back("--output");
+        break;
+      }
+      for (const std::string& s : a)
+        argvs[i].push_back(s.c_str());
+      lines.push_back(getopt_port::command_line{(int)argvs[i].size(),
+                                                argvs[i].data()});
+    }
+  }
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_bulk_matches_getopt_parse) {
+  job_queue queue(5000);
+  getopt_spec* spec = getopt_compile("vo:", bulk_opts);
+  getopt_port::bulk_result single =
+    getopt_port::bulk_parse(queue.lines.data(), queue.lines.size(), spec, 1);
+  getopt_port::bulk_result parallel =
+    getopt_port::bulk_parse(queue.lines.data(), queue.lines.size(), spec, 8);
+
+  assert_equal(5000, (int)parallel.size());
+  assert_equal(2500, (int)parallel.num_errors());
+
+  for (std::size_t i = 0; i < queue.lines.size(); ++i) {
+    getopt_record records[8];
+    int operands[8];
+    getopt_result expected = {records, 8, 0, operands, 8, 0};
+    getopt_parse(queue.lines[i].argc, queue.lines[i].argv, spec, &expected);
+
+    const getopt_port::bulk_entry& entry = parallel[i];
+    assert_equal(expected.num_records, (int)entry.num_records);
+    assert_equal(expected.num_operands, (int)entry.num_operands);
+    for (int r = 0; r < expected.num_records; ++r) {
+      const getopt_record& record = parallel.records(i)[r];
+      assert_equal(records[r].id, record.id);
+      assert_equal(records[r].index, record.index);
+      assert_equal(records[r].longindex, record.longindex);
+      assert_equal(records[r].arg, record.arg);
+      assert_equal(single.records(i)[r].id, record.id);
+    }
+    for (int o = 0; o < expected.num_operands; ++o)
+      assert_equal(operands[o], parallel.operands(i)[o]);
+    assert_equal(single[i].error, entry.error);
+  }
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_bulk_require_order) {
+  const char* argv[] = {"job", "-v", "in", "-o", "x", "--", "y"};
+  getopt_spec* spec = getopt_compile("+vo:", bulk_opts);
+  getopt_port::command_line line = {count(argv), argv};
+  getopt_port::bulk_result result = getopt_port::bulk_parse(&line, 1, spec);
+  getopt_record records[8];
+  int operands[8];
+  getopt_result expected = {records, 8, 0, operands, 8, 0};
+
+  // The same records and operands as getopt_parse(): everything from the
+  // first operand on is an operand.
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &expected));
+  assert_equal(1, expected.num_records);
+  assert_equal((size_t)expected.num_records, result[0].num_records);
+  assert_equal((size_t)expected.num_operands, result[0].num_operands);
+  for (int i = 0; i < expected.num_records; ++i) {
+    const getopt_record& record = result.records(0)[i];
+    assert_equal(records[i].id, record.id);
+    assert_equal(records[i].index, record.index);
+  }
+  for (int i = 0; i < expected.num_operands; ++i)
+    assert_equal(operands[i], result.operands(0)[i]);
+  assert_equal(0, result[0].error);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_bulk_errors) {
+  job_queue queue(4);
+  getopt_spec* spec = getopt_compile("vo:", bulk_opts);
+  getopt_port::bulk_result result =
+    getopt_port::bulk_parse(queue.lines.data(), queue.lines.size(), spec);
+
+  assert_equal(0, result[0].error);
+  assert_equal(0, result[1].error);
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, result[2].error);
+  assert_equal(2, result[2].error_index);
+  assert_equal(GETOPT_ERROR_MISSING_ARGUMENT, result[3].error);
+  assert_equal(3, result[3].error_index);
+  assert_equal(true, result[3].suggestion == NULL);
+
+  // Misspelled long options carry the likely intended name.
+  const char* typo[] = {"job", "--outptu=x"};
+  getopt_port::command_line line = {2, typo};
+  result = getopt_port::bulk_parse(&line, 1, spec);
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, result[0].error);
+  assert_equal(std::string("output"), std::string(result[0].suggestion));
+
+  // Nothing to parse.
+  assert_equal(0, (int)getopt_port::bulk_parse(NULL, 0, spec).size());
+
+  getopt_spec_free(spec);
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+namespace {
+
+const option remote_add_opts[] = {
+  {"tags", no_argument, NULL, 't'},
+  {"fetch", no_argument, NULL, 'f'},
+  {0, 0, 0, 0}
+};
+
+const option root_opts[] = {
+  {"verbose", no_argument, NULL, 'v'},
+  {"git-dir", required_argument, NULL, 'g'},
+  {0, 0, 0, 0}
+};
+
+// Listed out of order, to be sorted by getopt_command_compile().
+const getopt_command remote_commands[] = {
+  {"remove", "", NULL, NULL, 3},
+  {"add", "tf", remote_add_opts, NULL, 2},
+  {NULL, NULL, NULL, NULL, 0}
+};
+
+const getopt_command root_commands[] = {
+  {"status", "s", NULL, NULL, 4},
+  {"remote", "v", NULL, remote_commands, 1},
+  {NULL, NULL, NULL, NULL, 0}
+};
+
+const getopt_command git = {"git", "vC:", root_opts, root_commands, 0};
+
+void record_error(void* context, const getopt_diagnostic* diagnostic) {
+  *static_cast<int*>(context) = diagnostic->error;
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_command_dispatch) {
+  const char* argv[] = {"git", "-v", "--git-dir", "d", "remote", "-v", "add",
+                        "origin", "--tags", "url", "-f"};
+  getopt_command_tree* tree = getopt_command_compile(&git);
+  const getopt_command* command = NULL;
+  getopt_state state = {0};
+
+  assert_equal('v', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal("git", command->name);
+  assert_equal('g', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal("d", state.optarg);
+
+  assert_equal(GETOPT_COMMAND, getopt_command_r(count(argv), argv, tree,
+    &command, NULL, &state));
+  assert_equal("remote", state.optarg);
+  assert_equal(1, command->id);
+  assert_equal(5, state.optind);
+  assert_equal('v', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+
+  assert_equal(GETOPT_COMMAND, getopt_command_r(count(argv), argv, tree,
+    &command, NULL, &state));
+  assert_equal(2, command->id);
+
+  // The leaf command permutes its operands to the end, but not before its
+  // own name.
+  assert_equal('t', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal('f', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal(-1, getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal(9, state.optind);
+  assert_equal("add", argv[6]);
+  assert_equal("--tags", argv[7]);
+  assert_equal("-f", argv[8]);
+  assert_equal("origin", argv[9]);
+  assert_equal("url", argv[10]);
+  assert_equal("add", command->name);
+
+  getopt_command_tree_free(tree);
+}
+
+TEST_F(getopt_fixture, test_getopt_command_options_stay_on_their_level) {
+  const char* argv[] = {"git", "status", "-v"};
+  getopt_command_tree* tree = getopt_command_compile(&git);
+  getopt_state state = {0};
+
+  assert_equal(GETOPT_COMMAND, getopt_command_r(count(argv), argv, tree, NULL,
+    NULL, &state));
+  assert_equal('?', getopt_command_r(count(argv), argv, tree, NULL, NULL,
+    &state));
+  assert_equal('v', state.optopt);
+
+  getopt_command_tree_free(tree);
+}
+
+TEST_F(getopt_fixture, test_getopt_command_unknown) {
+  const char* argv[] = {"git", "remote", "rename", "a", "b"};
+  getopt_command_tree* tree = getopt_command_compile(&git);
+  const getopt_command* command = NULL;
+  getopt_state state = {0};
+  int error = 0;
+  state.diagnose = record_error;
+  state.diagnose_context = &error;
+
+  assert_equal(GETOPT_COMMAND, getopt_command_r(count(argv), argv, tree,
+    &command, NULL, &state));
+  assert_equal('?', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal(GETOPT_ERROR_UNKNOWN_COMMAND, error);
+  assert_equal("rename", state.optarg);
+  assert_equal(3, state.optind);
+  assert_equal("remote", command->name);
+
+  getopt_command_tree_free(tree);
+}
+
+TEST_F(getopt_fixture, test_getopt_command_double_dash) {
+  const char* argv[] = {"git", "-v", "--", "remote"};
+  getopt_command_tree* tree = getopt_command_compile(&git);
+  const getopt_command* command = NULL;
+  getopt_state state = {0};
+
+  assert_equal('v', getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal(-1, getopt_command_r(count(argv), argv, tree, &command, NULL,
+    &state));
+  assert_equal(3, state.optind);
+  assert_equal("git", command->name);
+
+  getopt_command_tree_free(tree);
+}
@@ -0,0 +1,209 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+const option remote_opts[] = {
+  {"verbose", no_argument, NULL, 'v'},
+  {0, 0, 0, 0}
+};
+
+const option root_opts[] = {
+  {"color", required_argument, NULL, 'c'},
+  {"colour", required_argument, NULL, 'c'},
+  {"git-dir", required_argument, NULL, 'g'},
+  {"verbose", no_argument, NULL, 'v'},
+  {"version", no_argument, NULL, 'V'},
+  {0, 0, 0, 0}
+};
+
+const getopt_command remote_commands[] = {
+  {"rename", "", NULL, NULL, 4},
+  {"remove", "", NULL, NULL, 3},
+  {"add", "", NULL, NULL, 2},
+  {NULL, NULL, NULL, NULL, 0}
+};
+
+const getopt_command root_commands[] = {
+  {"status", "", NULL, NULL, 5},
+  {"remote", "v", remote_opts, remote_commands, 1},
+  {"reset", "", NULL, NULL, 6},
+  {NULL, NULL, NULL, NULL, 0}
+};
+
+const getopt_command git = {"git", "vc:C:", root_opts, root_commands, 0};
+
+const char* const colors[] = {"always", "auto", "never", NULL};
+
+void collect(void* context, const char* prefix, const char* candidate,
+  size_t length) {
+  static_cast<std::vector<std::string>*>(context)->push_back(
+    std::string(prefix) + std::string(candidate, length));
+}
+
+struct completer {
+  getopt_command_tree* tree;
+  getopt_keywords* color_keywords;
+  int color;
+
+  completer()
+    : tree(getopt_command_compile(&git)),
+    color_keywords(getopt_keywords_compile(colors)),
+    color(0) {
+  }
+
+  ~completer() {
+    getopt_keywords_free(color_keywords);
+    getopt_command_tree_free(tree);
+  }
+
+  // Completes the last of args, returning the candidates joined by spaces.
+  std::string complete(const std::vector<const char*>& args) {
+    const getopt_value values[] = {
+      {'c', GETOPT_TYPE_ENUM, &color, 0, 0, color_keywords},
+      {0, 0, NULL, 0, 0, NULL}
+    };
+    std::vector<const char*> argv(1, "git");
+    std::vector<std::string> candidates;
+    std::string joined;
+    int count = 0;
+
+    argv.insert(argv.end(), args.begin(), args.end());
+    count = getopt_complete(tree, values, (int)argv.size(), &argv[0],
+      collect, &candidates);
+    assert_equal((size_t)count, candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i)
+      joined += (i ? " " : "") + candidates[i];
+    return joined;
+  }
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_spec_complete) {
+  getopt_spec* spec = getopt_compile("", root_opts);
+  const int* matches = NULL;
+
+  assert_equal(2, getopt_spec_complete(spec, "ver", 3, &matches));
+  assert_equal(3, matches[0]);
+  assert_equal(4, matches[1]);
+
+  // The length bounds the prefix.
+  assert_equal(5, getopt_spec_complete(spec, "verbose", 0, &matches));
+  assert_equal(0, matches[0]);
+  assert_equal(2, getopt_spec_complete(spec, "colorful", 4, &matches));
+  assert_equal(1, getopt_spec_complete(spec, "colour", 6, &matches));
+  assert_equal(1, matches[0]);
+
+  assert_equal(0, getopt_spec_complete(spec, "x", 1, &matches));
+  assert_equal(true, matches == NULL);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_complete_options) {
+  completer c;
+
+  assert_equal("--verbose --version", c.complete({"--ver"}));
+  assert_equal("--color --colour", c.complete({"-v", "--col"}));
+  assert_equal("", c.complete({"--x"}));
+  assert_equal("-v -c -C --color --colour --git-dir --verbose --version",
+    c.complete({"-"}));
+
+  // "--" is the empty prefix of every long option.
+  assert_equal("--color --colour --git-dir --verbose --version",
+    c.complete({"--"}));
+  assert_equal("", c.complete({"status", "--"}));
+
+  // Options of the current command.
+  assert_equal("--verbose", c.complete({"remote", "--v"}));
+  assert_equal("--verbose", c.complete({"remote", "--"}));
+
+  // Nothing is an option after "--", nor inside a cluster.
+  assert_equal("", c.complete({"--", "--ver"}));
+  assert_equal("", c.complete({"--", "--"}));
+  assert_equal("", c.complete({"--", "x", "--ver"}));
+  assert_equal("--verbose --version", c.complete({"-C", "--", "--ver"}));
+  assert_equal("", c.complete({"-vc"}));
+}
+
+TEST_F(getopt_fixture, test_getopt_complete_values) {
+  completer c;
+
+  assert_equal("always auto", c.complete({"--color", "a"}));
+  assert_equal("always auto never", c.complete({"-vc", ""}));
+  assert_equal("never", c.complete({"--colou", "n"}));
+  assert_equal("auto", c.complete({"--colour=au"}));
+
+  // Arguments of options without keywords, and values already given.
+  assert_equal("", c.complete({"--git-dir", ""}));
+  assert_equal("", c.complete({"-C", ""}));
+  assert_equal("reset", c.complete({"--color", "auto", "res"}));
+
+  // Completing does not store the value.
+  assert_equal(0, c.color);
+}
+
+TEST_F(getopt_fixture, test_getopt_complete_commands) {
+  completer c;
+
+  assert_equal("remote reset", c.complete({"re"}));
+  assert_equal("remote", c.complete({"-v", "rem"}));
+  assert_equal("remote reset status", c.complete({""}));
+  assert_equal("remove rename", c.complete({"remote", "-v", "re"}));
+  assert_equal("add", c.complete({"remote", "a"}));
+  assert_equal("", c.complete({"status", ""}));
+  assert_equal("", c.complete({"x"}));
+}
+
+#if !defined(GETOPT_NO_STDIO) && !defined(_WIN32)
+TEST_F(getopt_fixture, test_getopt_complete_main) {
+  getopt_command_tree* tree = getopt_command_compile(&git);
+
+  unsetenv("COMP_LINE");
+  assert_equal(0, getopt_complete_main(tree, NULL));
+
+  // Answers even when there is nothing to print, or the line is unfinished.
+  setenv("COMP_LINE", "git status --verbose", 1);
+  setenv("COMP_POINT", "11", 1);
+  assert_equal(1, getopt_complete_main(tree, NULL));
+  setenv("COMP_LINE", "git 'st", 1);
+  unsetenv("COMP_POINT");
+  assert_equal(1, getopt_complete_main(tree, NULL));
+  unsetenv("COMP_LINE");
+  getopt_command_tree_free(tree);
+}
+#endif
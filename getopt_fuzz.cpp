@@ -0,0 +1,541 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+// Fuzz harness for the parsers. An input is a flags byte followed by
+// NUL-separated strings: the optstring, a comma-separated list of long
+// option names, each optionally ending in a digit 0-2 for has_arg, and
+// the argv elements.
+//
+// Every input is parsed with getopt_long_r() and with a compiled spec,
+// which must agree step by step and permute argv identically, and with
+// getopt_parse(), which must find the same options as an in-order parse.
+// basic_getopt_long_r(), the same core instantiated for wchar_t, must agree
+// with getopt_long_r() too on the input widened to wchar_t.
+// Built with GETOPT_FUZZ_GLIBC, inputs within the grammar both accept are
+// also compared against glibc's getopt_long().
+//
+// Built with GETOPT_LIBFUZZER, this is a libFuzzer target. Otherwise it
+// runs the files named on the command line, or stdin (for AFL), or with -n,
+// that many generated inputs:
+//
+//   fuzz_getopt_port [-n iterations] [-s seed] [files...]
+
+#include "getopt.h"
+#include "getopt_basic.hpp"
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(GETOPT_FUZZ_GLIBC)
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+const int flag_no_longopts = 0x1;
+
+struct fuzz_input {
+  int flags;
+  std::string optstring;
+  std::vector<std::string> names;
+  std::vector<int> has_arg;
+  std::vector<std::string> args;
+};
+
+void check(bool condition, const char* what) {
+  if (!condition) {
+    fprintf(stderr, "fuzz_getopt_port: %s\n", what);
+    abort();
+  }
+}
+
+fuzz_input decode(const uint8_t* data, size_t size) {
+  fuzz_input input;
+  std::vector<std::string> strings;
+  size_t i = 0;
+
+  input.flags = size > 0 ? data[0] : 0;
+  for (i = 1; i < size && strings.size() < 66;) {
+    const char* begin = (const char*)data + i;
+    size_t length = strnlen(begin, size - i);
+    strings.push_back(std::string(begin, length));
+    i += length + 1;
+  }
+  strings.resize(std::max<size_t>(strings.size(), 2));
+
+  input.optstring = strings[0];
+  for (size_t begin = 0; begin < strings[1].size();) {
+    size_t end = strings[1].find(',', begin);
+    if (end == std::string::npos)
+      end = strings[1].size();
+    std::string name = strings[1].substr(begin, end - begin);
+    int has_arg = no_argument;
+    if (!name.empty() && name.back() >= '0' && name.back() <= '2') {
+      has_arg = no_argument + (name.back() - '0');
+      name.pop_back();
+    }
+    if (!name.empty() && name.find('=') == std::string::npos) {
+      input.names.push_back(name);
+      input.has_arg.push_back(has_arg);
+    }
+    begin = end + 1;
+  }
+  input.args.assign(strings.begin() + 2, strings.end());
+  return input;
+}
+
+std::vector<uint8_t> encode(const fuzz_input& input) {
+  std::string bytes(1, (char)input.flags);
+  bytes += input.optstring;
+  bytes += '\0';
+  for (size_t i = 0; i < input.names.size(); ++i) {
+    if (i > 0)
+      bytes += ',';
+    bytes += input.names[i];
+    bytes += (char)('0' + input.has_arg[i] - no_argument);
+  }
+  for (size_t i = 0; i < input.args.size(); ++i) {
+    bytes += '\0';
+    bytes += input.args[i];
+  }
+  return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+// One call's observable outcome.
+struct step {
+  int retval;
+  int longindex;
+  int optind;
+  const char* optarg;
+
+  bool operator==(const step& other) const {
+    return retval == other.retval && longindex == other.longindex &&
+      optind == other.optind && optarg == other.optarg;
+  }
+};
+
+// The options and argv of an input, as the parsers take them.
+struct parse_args {
+  std::vector<option> longopts;
+  std::vector<const char*> argv;
+
+  explicit parse_args(const fuzz_input& input) {
+    for (size_t i = 0; i < input.names.size(); ++i) {
+      option o = {input.names[i].c_str(), input.has_arg[i], NULL,
+                  256 + (int)i};
+      longopts.push_back(o);
+    }
+    option end = {0, 0, 0, 0};
+    longopts.push_back(end);
+
+    argv.push_back("fuzz");
+    for (size_t i = 0; i < input.args.size(); ++i)
+      argv.push_back(input.args[i].c_str());
+    argv.push_back(NULL);
+  }
+
+  int argc() const {
+    return (int)argv.size() - 1;
+  }
+};
+
+// Parses with getopt_long_r(), and with the same tables compiled; both
+// must behave identically.
+void check_linear_against_compiled(const fuzz_input& input,
+                                   const parse_args& args,
+                                   const getopt_spec* spec) {
+  std::vector<const char*> argv1 = args.argv;
+  std::vector<const char*> argv2 = args.argv;
+  const option* longopts =
+    (input.flags & flag_no_longopts) ? NULL : &args.longopts[0];
+  getopt_state state1 = {0};
+  getopt_state state2 = {0};
+  int argc = args.argc();
+
+  // Every call consumes at least one character of argv.
+  for (int calls = 0;; ++calls) {
+    check(calls <= 2 * (int)encode(input).size() + 2, "parse does not end");
+
+    step s1 = {0, -1, 0, NULL};
+    step s2 = {0, -1, 0, NULL};
+    if (longopts)
+      s1.retval = getopt_long_r(argc, &argv1[0], input.optstring.c_str(),
+                                longopts, &s1.longindex, &state1);
+    else
+      s1.retval = getopt_r(argc, &argv1[0], input.optstring.c_str(),
+                           &state1);
+    s2.retval = getopt_compiled_r(argc, &argv2[0], spec, &s2.longindex,
+                                  &state2);
+    s1.optind = state1.optind;
+    s1.optarg = state1.optarg;
+    s2.optind = state2.optind;
+    s2.optarg = state2.optarg;
+    check(s1 == s2, "compiled spec differs from getopt_long_r()");
+
+    if (s1.retval == -1)
+      break;
+    check(s1.optind >= 1 && s1.optind <= argc + 1, "optind out of range");
+  }
+
+  check(state1.optind >= 1 && state1.optind <= argc, "final optind");
+  check(argv1 == argv2, "compiled spec permutes differently");
+
+  std::vector<const char*> sorted1 = argv1;
+  std::vector<const char*> sorted2 = args.argv;
+  std::sort(sorted1.begin(), sorted1.end());
+  std::sort(sorted2.begin(), sorted2.end());
+  check(sorted1 == sorted2, "argv is not a permutation");
+}
+
+// getopt_parse() must report the options of an in-order parse, and both
+// must leave argv alone.
+void check_parse_against_in_order(const fuzz_input& input,
+                                  const parse_args& args,
+                                  const getopt_spec* spec) {
+  std::vector<const char*> argv = args.argv;
+  std::vector<int> operands(argv.size());
+  size_t max_records = 1;
+
+  // At most one option per character.
+  for (int i = 1; i < args.argc(); ++i)
+    max_records += strlen(argv[i]);
+  std::vector<getopt_record> records(max_records);
+  getopt_result result = {&records[0], (int)records.size(), 0,
+                          &operands[0], (int)operands.size(), 0};
+  getopt_state state = {0};
+  int argc = args.argc();
+  int n = 0;
+
+  check(getopt_parse(argc, &argv[0], spec, &result) == 0,
+        "getopt_parse() out of room");
+
+  state.flags = GETOPT_RETURN_IN_ORDER;
+  for (;;) {
+    int longindex = -1;
+    int retval = getopt_compiled_r(argc, &argv[0], spec, &longindex, &state);
+    if (retval == -1)
+      break;
+    // Operands are returned as 1, without an option name. A '+' optstring
+    // makes the first of them end the options.
+    if (retval == 1 && state.optname.data == NULL) {
+      if (input.optstring[0] == '+')
+        break;
+      continue;
+    }
+    check(n < result.num_records, "getopt_parse() misses options");
+    check(records[n].id == retval, "getopt_parse() id");
+    check(records[n].arg == state.optarg, "getopt_parse() arg");
+    ++n;
+  }
+  check(n == result.num_records, "getopt_parse() finds extra options");
+  check(argv == args.argv, "in-order parse wrote to argv");
+}
+
+// Widens each byte on its own, sign and all, as the narrow parser sees it.
+std::wstring widen(const char* s) {
+  std::wstring wide;
+  for (; *s != '\0'; ++s)
+    wide += (wchar_t)(signed char)*s;
+  return wide;
+}
+
+// The character-generic parser on wchar_t must behave exactly like
+// getopt_long_r() on the same input.
+void check_wide_against_narrow(const fuzz_input& input,
+                               const parse_args& args) {
+  std::vector<const char*> argv = args.argv;
+  std::vector<std::wstring> wide_strings;
+  std::vector<getopt_port::woption> wide_longopts;
+  std::vector<const wchar_t*> wide_argv;
+  std::wstring optstring = widen(input.optstring.c_str());
+  const option* longopts =
+    (input.flags & flag_no_longopts) ? NULL : &args.longopts[0];
+  getopt_state state = {0};
+  getopt_port::wgetopt_state wide_state;
+  int argc = args.argc();
+
+  // Reserved, so that the pointers taken below stay valid.
+  wide_strings.reserve(args.longopts.size() + argv.size());
+  for (size_t i = 0; i + 1 < args.longopts.size(); ++i) {
+    wide_strings.push_back(widen(args.longopts[i].name));
+    getopt_port::woption o = {wide_strings.back().c_str(),
+                              args.longopts[i].has_arg, NULL,
+                              args.longopts[i].val};
+    wide_longopts.push_back(o);
+  }
+  getopt_port::woption end = {0, 0, 0, 0};
+  wide_longopts.push_back(end);
+  for (int i = 0; i < argc; ++i) {
+    wide_strings.push_back(widen(argv[i]));
+    wide_argv.push_back(wide_strings.back().c_str());
+  }
+  wide_argv.push_back(NULL);
+
+  for (;;) {
+    step s1 = {0, -1, 0, NULL};
+    step s2 = {0, -1, 0, NULL};
+    if (longopts) {
+      s1.retval = getopt_long_r(argc, &argv[0], input.optstring.c_str(),
+                                longopts, &s1.longindex, &state);
+      s2.retval = getopt_port::basic_getopt_long_r(argc, &wide_argv[0],
+        optstring.c_str(), &wide_longopts[0], &s2.longindex, wide_state);
+    } else {
+      s1.retval = getopt_r(argc, &argv[0], input.optstring.c_str(), &state);
+      s2.retval = getopt_port::basic_getopt_r(argc, &wide_argv[0],
+        optstring.c_str(), wide_state);
+    }
+    check(s1.retval == s2.retval && s1.longindex == s2.longindex &&
+          state.optind == wide_state.optind &&
+          state.optopt == wide_state.optopt,
+          "wide parse differs from getopt_long_r()");
+    check((state.optarg == NULL) == (wide_state.optarg == NULL) &&
+          (state.optarg == NULL || widen(state.optarg) == wide_state.optarg),
+          "wide optarg differs");
+    if (s1.retval == -1)
+      break;
+  }
+
+  for (int i = 0; i < argc; ++i)
+    check(widen(argv[i]) == wide_argv[i], "wide parse permutes differently");
+}
+
+#if defined(GETOPT_FUZZ_GLIBC)
+typedef int (*glibc_getopt_long_fn)(int, char* const*, const char*,
+                                    const option*, int*);
+
+// glibc's getopt_long() works on the optarg/optind/opterr/optopt globals,
+// which getopt.c defines and so takes over from libc.
+glibc_getopt_long_fn glibc_getopt_long() {
+  static glibc_getopt_long_fn fn =
+    (glibc_getopt_long_fn)dlsym(RTLD_NEXT, "getopt_long");
+  check(fn != NULL && (void*)fn != (void*)&getopt_long,
+        "glibc getopt_long() not found");
+  return fn;
+}
+
+// The grammar where the implementations are meant to agree: no "W;" in
+// optstring, long option names without abbreviation-only
+// differences, and no "-" arguments, which end parsing here but are
+// operands to glibc. Differences in error codes are not compared.
+bool in_common_grammar(const fuzz_input& input) {
+  if (input.flags & flag_no_longopts)
+    return false;
+  for (size_t i = 0; i < input.optstring.size(); ++i) {
+    char c = input.optstring[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'V') ||
+          (c >= '0' && c <= '9') || (c == ':' && i > 0) ||
+          ((c == '+' || c == '-') && i == 0)))
+      return false;
+  }
+  for (size_t i = 0; i < input.names.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (input.names[i] == input.names[j])
+        return false;
+    }
+  }
+  for (size_t i = 0; i < input.args.size(); ++i) {
+    if (input.args[i] == "-")
+      return false;
+  }
+  return true;
+}
+
+void check_against_glibc(const fuzz_input& input, const parse_args& args) {
+  // glibc numbers has_arg from 0.
+  std::vector<option> glibc_longopts = args.longopts;
+  for (size_t i = 0; i + 1 < glibc_longopts.size(); ++i)
+    glibc_longopts[i].has_arg -= no_argument;
+
+  std::vector<const char*> argv1 = args.argv;
+  std::vector<const char*> argv2 = args.argv;
+  getopt_state state = {0};
+  int argc = args.argc();
+
+  optind = 0;
+  opterr = 0;
+  for (;;) {
+    step s1 = {0, -1, 0, NULL};
+    step s2 = {0, -1, 0, NULL};
+    s1.retval = getopt_long_r(argc, &argv1[0], input.optstring.c_str(),
+                              &args.longopts[0], &s1.longindex, &state);
+    s1.optind = state.optind;
+    s1.optarg = state.optarg;
+    s2.retval = glibc_getopt_long()(argc, (char* const*)&argv2[0],
+                                    input.optstring.c_str(),
+                                    &glibc_longopts[0], &s2.longindex);
+    s2.optind = optind;
+    s2.optarg = optarg;
+
+    bool error1 = s1.retval == '?' || s1.retval == ':';
+    bool error2 = s2.retval == '?' || s2.retval == ':';
+    check(error1 == error2, "error differs from glibc");
+    if (error1)
+      return;
+    check(s1 == s2, "differs from glibc");
+    if (s1.retval == -1)
+      break;
+  }
+  check(argv1 == argv2, "permutes argv differently from glibc");
+}
+#endif
+
+void run(const uint8_t* data, size_t size) {
+  fuzz_input input = decode(data, size);
+  parse_args args(input);
+  getopt_spec* spec = getopt_compile(input.optstring.c_str(),
+    (input.flags & flag_no_longopts) ? NULL : &args.longopts[0]);
+
+  check(spec != NULL, "out of memory");
+  check_linear_against_compiled(input, args, spec);
+  check_parse_against_in_order(input, args, spec);
+  check_wide_against_narrow(input, args);
+#if defined(GETOPT_FUZZ_GLIBC)
+  if (in_common_grammar(input))
+    check_against_glibc(input, args);
+#endif
+  getopt_spec_free(spec);
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  run(data, size);
+  return 0;
+}
+
+#if !defined(GETOPT_LIBFUZZER)
+namespace {
+
+// xorshift32, so that runs are reproducible from the seed.
+uint32_t next_random(uint32_t* seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+// Builds inputs from fragments that hit the interesting cases often:
+// names that prefix each other, clusters, '=' values, "--" and "-".
+fuzz_input generate(uint32_t* seed) {
+  static const char* const optstrings[] = {
+    "", "a", "ab:", "ab:c::", ":ab:", "abc:d::e", "x::y:z", "a:b:",
+    "+ab:", "-ab:c::", "+:a:b", "-:ab:", "a\xe9:", "-\xe9" "b::",
+  };
+  static const char* const names[] = {
+    "a", "ab", "abc", "alpha", "alphabet", "beta", "b", "bet", "c",
+    "\xe9t\xe9", "\xe9t",
+  };
+  static const char* const args[] = {
+    "-a", "-b", "-c", "-abc", "-ba", "-bvalue", "-cvalue", "-x", "-q", "-:",
+    "--a", "--ab", "--al", "--alpha", "--alpha=1", "--b=", "--be", "--c=x",
+    "--", "-", "--=", "---", "operand", "", "value", "-\xe9", "-a\xe9x",
+    "--\xe9", "--\xe9t\xe9=1", "\xe9",
+  };
+  const int num_optstrings = sizeof(optstrings) / sizeof(optstrings[0]);
+  const int num_names = sizeof(names) / sizeof(names[0]);
+  const int num_args = sizeof(args) / sizeof(args[0]);
+  fuzz_input input;
+
+  input.flags = next_random(seed) % 8 == 0 ? flag_no_longopts : 0;
+  input.optstring = optstrings[next_random(seed) % num_optstrings];
+  for (int i = (int)(next_random(seed) % 5); i > 0; --i) {
+    input.names.push_back(names[next_random(seed) % num_names]);
+    input.has_arg.push_back(no_argument + (int)(next_random(seed) % 3));
+  }
+  for (int i = (int)(next_random(seed) % 12); i > 0; --i)
+    input.args.push_back(args[next_random(seed) % num_args]);
+  return input;
+}
+
+bool run_file(FILE* file) {
+  std::vector<uint8_t> data;
+  char buffer[4096];
+  size_t n = 0;
+
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  if (ferror(file))
+    return false;
+
+  run(data.empty() ? NULL : &data[0], data.size());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  long iterations = 0;
+  uint32_t seed = 1;
+  int first_file = 0;
+  int c;
+
+  while ((c = getopt(argc, (const char**)argv, "n:s:")) != -1) {
+    switch (c) {
+    case 'n':
+      iterations = atol(optarg);
+      break;
+    case 's':
+      seed = (uint32_t)strtoul(optarg, NULL, 10);
+      if (seed == 0)
+        seed = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n iterations] [-s seed] [files...]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  // The glibc comparison overwrites optind.
+  first_file = optind;
+
+  for (long i = 0; i < iterations; ++i) {
+    std::vector<uint8_t> data = encode(generate(&seed));
+    run(&data[0], data.size());
+  }
+
+  if (iterations == 0 && first_file == argc && !run_file(stdin))
+    return 1;
+
+  for (int i = first_file; i < argc; ++i) {
+    FILE* file = fopen(argv[i], "rb");
+    if (file == NULL || !run_file(file)) {
+      fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+      return 1;
+    }
+    fclose(file);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,337 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#include "getopt.hpp"
+#include "testfx.h"
+#include "testsupport.h"
+
+using getopt_port::option_name;
+using getopt_port::option_value;
+
+namespace {
+
+option slice_opts[] = {
+  {"level", optional_argument, NULL, 'l'},
+  {"output", required_argument, NULL, 'o'},
+  {"verbose", no_argument, NULL, 'v'},
+  {0, 0, 0, 0}
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_long_name_and_value) {
+  const char* argv[] = {"foo.exe", "--output=out.txt", "--verb", "--level=",
+                        "--output", "next"};
+  getopt_state state = {0};
+
+  assert_equal('o', getopt_long_r(count(argv), argv, "", slice_opts, NULL,
+    &state));
+  assert_equal("output", option_name(state));
+  assert_equal("out.txt", option_value(state));
+  assert_equal(argv[1] + 9, option_value(state).data());
+
+  // The name is as written, even if abbreviated.
+  assert_equal('v', getopt_long_r(count(argv), argv, "", slice_opts, NULL,
+    &state));
+  assert_equal("verb", option_name(state));
+  assert_equal(true, option_value(state).data() == nullptr);
+
+  // An empty value is present, unlike a missing one.
+  assert_equal('l', getopt_long_r(count(argv), argv, "", slice_opts, NULL,
+    &state));
+  assert_equal("level", option_name(state));
+  assert_equal(true, option_value(state).data() != nullptr);
+  assert_equal(0, (int)option_value(state).size());
+
+  assert_equal('o', getopt_long_r(count(argv), argv, "", slice_opts, NULL,
+    &state));
+  assert_equal("output", option_name(state));
+  assert_equal("next", option_value(state));
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_short_name_and_value) {
+  const char* argv[] = {"foo.exe", "-vofile", "-o", "other"};
+  getopt_state state = {0};
+
+  assert_equal('v', getopt_r(count(argv), argv, "vo:", &state));
+  assert_equal("v", option_name(state));
+  assert_equal(true, option_value(state).data() == nullptr);
+  assert_equal('o', getopt_r(count(argv), argv, "vo:", &state));
+  assert_equal("o", option_name(state));
+  assert_equal("file", option_value(state));
+  assert_equal('o', getopt_r(count(argv), argv, "vo:", &state));
+  assert_equal("other", option_value(state));
+  assert_equal(-1, getopt_r(count(argv), argv, "vo:", &state));
+  assert_equal(true, option_name(state).data() == nullptr);
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_record_value) {
+  const char* const argv[] = {"foo.exe", "--output=a=b", "--level"};
+  getopt_spec* spec = getopt_compile("", slice_opts);
+  getopt_record records[2];
+  getopt_result result = {records, 2, 0, NULL, 0, 0};
+
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(3, (int)records[0].arg_length);
+  assert_equal("a=b", option_value(records[0]));
+  assert_equal(true, option_value(records[1]).data() == nullptr);
+
+  getopt_spec_free(spec);
+}
+
+namespace {
+
+constexpr option schema_opts[] = {
+  {"first", no_argument, nullptr, 'f'},
+  {"fir", no_argument, nullptr, 'F'},
+  {"second", required_argument, nullptr, 's'},
+  {"seconds", optional_argument, nullptr, 'S'},
+  {"third", optional_argument, nullptr, 't'},
+};
+
+constexpr getopt_port::schema cli("fs:t::", schema_opts);
+
+static_assert(cli.find("first") == 0, "exact names resolve at compile time");
+static_assert(cli.find("seconds") == 3, "exact names resolve at compile time");
+static_assert(cli.find("fi") == -1, "abbreviations are not exact names");
+
+option linear_opts[] = {
+  {"first", no_argument, NULL, 'f'},
+  {"fir", no_argument, NULL, 'F'},
+  {"second", required_argument, NULL, 's'},
+  {"seconds", optional_argument, NULL, 'S'},
+  {"third", optional_argument, NULL, 't'},
+  {0, 0, 0, 0}
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_schema_matches_getopt_long) {
+  const char* args[] = {"foo.exe", "--fir", "--firs", "--fi", "op1",
+                        "--second", "x", "--seco=y", "--seconds=z", "--th",
+                        "-fs", "w", "--bogus", "-q", "--first=1", "-t",
+                        "op2", "--", "--first"};
+  const int argc = sizeof(args) / sizeof(args[0]);
+  const char* argv1[argc];
+  const char* argv2[argc];
+  getopt_state state1 = {0};
+  getopt_state state2 = {0};
+
+  for (int i = 0; i < argc; ++i)
+    argv1[i] = argv2[i] = args[i];
+
+  for (;;) {
+    int longindex1 = -1;
+    int longindex2 = -1;
+    int c1 = cli.parse(argc, argv1, &longindex1, &state1);
+    int c2 = getopt_long_r(argc, argv2, "fs:t::", linear_opts, &longindex2,
+                           &state2);
+    assert_equal(c2, c1);
+    assert_equal(longindex2, longindex1);
+    assert_equal(state2.optind, state1.optind);
+    assert_equal(state2.optarg, state1.optarg);
+    if (c1 == -1)
+      break;
+  }
+
+  for (int i = 0; i < argc; ++i)
+    assert_equal(argv2[i], argv1[i]);
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_schema_rejects_duplicates) {
+  option duplicate[] = {
+    {"name", no_argument, NULL, 'n'},
+    {"other", no_argument, NULL, 'o'},
+    {"name", required_argument, NULL, 'N'},
+  };
+  option unnamed[] = {
+    {"", no_argument, NULL, 'n'},
+  };
+  option valid[] = {
+    {"name", no_argument, NULL, 'n'},
+  };
+  bool thrown = false;
+
+  // Declared constexpr, these would not compile.
+  try {
+    getopt_port::schema s("", duplicate);
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+  assert_equal(true, thrown);
+
+  thrown = false;
+  try {
+    getopt_port::schema s("", unnamed);
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+  assert_equal(true, thrown);
+
+  thrown = false;
+  try {
+    getopt_port::schema s("ab:ca", valid);
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+  assert_equal(true, thrown);
+}
+
+namespace {
+
+constexpr const char* mode_names[] = {"fast", "safe", "debug", "fastest",
+                                      "safer", "trace", "off", "on", "auto"};
+
+constexpr getopt_port::keywords modes(mode_names);
+
+static_assert(modes.find("fast") == 0, "keywords resolve at compile time");
+static_assert(modes.find("auto") == 8, "keywords resolve at compile time");
+static_assert(modes.find("fas") == -1, "prefixes are not keywords");
+
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_keywords) {
+  const char* argv[] = {"foo.exe", "--mode=safer", "-mdebu"};
+  option opts[] = {
+    {"mode", required_argument, NULL, 'm'},
+    {0, 0, 0, 0}
+  };
+  int mode = -1;
+  getopt_value values[] = {
+    {'m', GETOPT_TYPE_ENUM, &mode, 0, 0, modes.table()},
+    {0, 0, NULL, 0, 0, NULL}
+  };
+  getopt_state state = {0};
+  state.values = values;
+
+  for (int i = 0; i < 9; ++i)
+    assert_equal(i, modes.find(mode_names[i]));
+
+  assert_equal('m', getopt_long_r(count(argv), argv, "m:", opts, NULL,
+    &state));
+  assert_equal(4, mode);
+  assert_equal('?', getopt_long_r(count(argv), argv, "m:", opts, NULL,
+    &state));
+  assert_equal(4, mode);
+
+  const char* duplicate[] = {"a", "b", "a"};
+  bool thrown = false;
+  try {
+    getopt_port::keywords k(duplicate);
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+  assert_equal(true, thrown);
+}
+
+namespace {
+
+// Counts allocations passed on to the default resource.
+struct counting_resource : std::pmr::memory_resource {
+  int allocations = 0;
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes,
+                     std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_parse_result_inline) {
+  const char* const argv[] = {"foo.exe", "--second=a", "in1", "-f", "-s",
+                              "x", "in2", "--third", "b"};
+  counting_resource arena;
+  getopt_port::parse_result<> result(&arena);
+
+  result.parse(count(argv), argv, cli);
+  assert_equal(0, arena.allocations);
+  assert_equal(4, (int)result.size());
+  assert_equal('s', result[0].id);
+  assert_equal('f', result[1].id);
+  assert_equal('t', result[3].id);
+  assert_equal(2, (int)result.count('s'));
+  assert_equal("x", result.value('s'));
+  assert_equal(true, result.value('t').data() == nullptr);
+  assert_equal(true, result.find('F') == nullptr);
+  assert_equal(3, (int)result.num_operands());
+  assert_equal("in1", result.operand(0));
+  assert_equal("b", result.operand(2));
+  assert_equal(8, result.operand_index(2));
+
+  // The same through a runtime spec.
+  getopt_spec* spec = getopt_compile("fs:t::", linear_opts);
+  result.parse(count(argv), argv, spec);
+  assert_equal(0, arena.allocations);
+  assert_equal(4, (int)result.size());
+  assert_equal("a", option_value(result[0]));
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_parse_result_allocates_once) {
+  const char* const argv[] = {"foo.exe", "-f", "-f", "-f", "-f", "in1",
+                              "in2", "-s", "x"};
+  counting_resource arena;
+  getopt_port::parse_result<2, 1> result(&arena);
+
+  result.parse(count(argv), argv, cli);
+  assert_equal(1, arena.allocations);
+  assert_equal(5, (int)result.size());
+  assert_equal(4, (int)result.count('f'));
+  assert_equal("x", result.value('s'));
+  assert_equal(2, (int)result.num_operands());
+  assert_equal("in2", result.operand(1));
+
+  // A parse that fits the block does not allocate again.
+  result.parse(count(argv), argv, cli);
+  assert_equal(1, arena.allocations);
+  assert_equal(5, (int)result.size());
+}
+
+TEST_F(getopt_fixture, test_getopt_hpp_parse_result_monotonic_arena) {
+  const char* const argv[] = {"foo.exe", "-f", "-f", "-f", "in"};
+  char buffer[256];
+  std::pmr::monotonic_buffer_resource arena(
+      buffer, sizeof(buffer), std::pmr::null_memory_resource());
+  getopt_port::parse_result<1, 1> result(&arena);
+
+  result.parse(count(argv), argv, cli);
+  assert_equal(3, (int)result.size());
+  assert_equal("in", result.operand(0));
+}
@@ -30,6 +30,9 @@
 #include "testfx.h"
 #include "testsupport.h"
 
+#include <string.h>
+#include <string>
+
 option null_opt = {0};
 
 TEST_F(getopt_fixture, test_getopt_long_empty) {
@@ -353,3 +356,46 @@ TEST_F(getopt_fixture, test_getopt_long_resets_optopt) {
   assert_equal('?', getopt_long(count(long_argv), long_argv, "a", opts, NULL));
   assert_equal(0, optopt);
 }
+
+TEST_F(getopt_fixture, test_getopt_long_name_value_at_any_alignment) {
+  // Names and values of every length, starting at every offset, so that
+  // '=' and the end fall everywhere within and across 16-byte blocks.
+  option opts[] = {
+    {"k", required_argument, NULL, 'k'},
+    {"kk", no_argument, NULL, 'K'},
+    null_opt
+  };
+  char buffer[128];
+
+  for (int offset = 0; offset < 16; ++offset) {
+    for (int value_length = 0; value_length < 40; ++value_length) {
+      std::string arg = "--k=" + std::string(value_length, 'v');
+      memcpy(buffer + offset, arg.c_str(), arg.size() + 1);
+      const char* argv[] = {"foo.exe", buffer + offset, "--kk"};
+      getopt_state state = {0};
+
+      assert_equal('k', getopt_long_r(count(argv), argv, "", opts, NULL,
+        &state));
+      assert_equal(1, (int)state.optname.length);
+      assert_equal(value_length, (int)state.optvalue.length);
+      assert_equal(buffer + offset + 4, state.optarg);
+      assert_equal('K', getopt_long_r(count(argv), argv, "", opts, NULL,
+        &state));
+      assert_equal(2, (int)state.optname.length);
+    }
+  }
+}
+
+TEST_F(getopt_fixture, test_getopt_long_long_value) {
+  option opts[] = {
+    {"blob", required_argument, NULL, 'b'},
+    null_opt
+  };
+  std::string arg = "--blob=" + std::string(300000, 'A') + "==";
+  const char* argv[] = {"foo.exe", arg.c_str()};
+  getopt_state state = {0};
+
+  assert_equal('b', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(300002, (int)state.optvalue.length);
+  assert_equal(arg.c_str() + 7, state.optarg);
+}
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+static const option parse_opts[] = {
+  {"verbose", no_argument, NULL, 'v'},
+  {"output", required_argument, NULL, 'o'},
+  {"level", optional_argument, NULL, 'l'},
+  {0, 0, 0, 0}
+};
+
+TEST_F(getopt_fixture, test_getopt_parse_mixed) {
+  const char* const argv[] = {"foo.exe", "in1", "-vx", "--output", "out",
+                              "in2", "--lev=3", "-oo2", "--", "-v"};
+  getopt_spec* spec = getopt_compile("vxo:l::", parse_opts);
+  getopt_record records[8];
+  int operands[8];
+  getopt_result result = {records, 8, 0, operands, 8, 0};
+
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(5, result.num_records);
+
+  assert_equal('v', records[0].id);
+  assert_equal(-1, records[0].longindex);
+  assert_equal(2, records[0].index);
+  assert_equal('x', records[1].id);
+  assert_equal(2, records[1].index);
+  assert_equal('o', records[2].id);
+  assert_equal(1, records[2].longindex);
+  assert_equal(3, records[2].index);
+  assert_equal("out", records[2].arg);
+  assert_equal('l', records[3].id);
+  assert_equal("3", records[3].arg);
+  assert_equal('o', records[4].id);
+  assert_equal("o2", records[4].arg);
+
+  assert_equal(3, result.num_operands);
+  assert_equal(1, operands[0]);
+  assert_equal(5, operands[1]);
+  assert_equal(9, operands[2]);
+
+  // argv is left as it was.
+  assert_equal("in1", argv[1]);
+  assert_equal("in2", argv[5]);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_parse_errors) {
+  const char* const argv[] = {"foo.exe", "-q", "--verbose=1", "--output"};
+  getopt_spec* spec = getopt_compile("vo:", parse_opts);
+  getopt_record records[4];
+  int operands[4];
+  getopt_result result = {records, 4, 0, operands, 4, 0};
+
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(3, result.num_records);
+  assert_equal('?', records[0].id);
+  assert_equal('?', records[1].id);
+  assert_equal(':', records[2].id);
+  assert_equal(0, result.num_operands);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_parse_single_dash) {
+  const char* const argv[] = {"foo.exe", "-v", "-", "-v"};
+  getopt_spec* spec = getopt_compile("v", NULL);
+  getopt_record records[4];
+  int operands[4];
+  getopt_result result = {records, 4, 0, operands, 4, 0};
+
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(1, result.num_records);
+  assert_equal(2, result.num_operands);
+  assert_equal(2, operands[0]);
+  assert_equal(3, operands[1]);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_parse_overflow) {
+  const char* const argv[] = {"foo.exe", "-vvv", "a", "b"};
+  getopt_spec* spec = getopt_compile("v", NULL);
+  getopt_record records[2];
+  int operands[1];
+  getopt_result result = {records, 2, 0, operands, 1, 0};
+
+  // The counts tell how much room would have been needed.
+  assert_equal(-1, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(3, result.num_records);
+  assert_equal(2, result.num_operands);
+  assert_equal('v', records[1].id);
+  assert_equal(2, operands[0]);
+
+  getopt_spec_free(spec);
+}
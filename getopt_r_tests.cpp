@@ -0,0 +1,314 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+TEST_F(getopt_fixture, test_getopt_r_zero_initialized_state) {
+  const char* argv[] = {"foo.exe", "-a", "-bvalue"};
+  getopt_state state = {0};
+
+  assert_equal('a', getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal(2, state.optind);
+  assert_equal('b', getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal("value", state.optarg);
+  assert_equal(-1, getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal(3, state.optind);
+}
+
+TEST_F(getopt_fixture, test_getopt_r_leaves_globals_alone) {
+  const char* argv[] = {"foo.exe", "-a", "value"};
+  getopt_state state = {0};
+
+  assert_equal('a', getopt_r(count(argv), argv, "a:", &state));
+  assert_equal("value", state.optarg);
+  assert_equal(1, optind);
+  assert_equal((char*)NULL, optarg);
+}
+
+TEST_F(getopt_fixture, test_getopt_r_interleaved_states) {
+  // Two clustered parses in flight at once must not share optcursor.
+  const char* argv1[] = {"foo.exe", "-abc"};
+  const char* argv2[] = {"bar.exe", "-xyz"};
+  getopt_state state1 = {0};
+  getopt_state state2 = {0};
+
+  assert_equal('a', getopt_r(count(argv1), argv1, "abc", &state1));
+  assert_equal('x', getopt_r(count(argv2), argv2, "xyz", &state2));
+  assert_equal('b', getopt_r(count(argv1), argv1, "abc", &state1));
+  assert_equal('y', getopt_r(count(argv2), argv2, "xyz", &state2));
+  assert_equal('c', getopt_r(count(argv1), argv1, "abc", &state1));
+  assert_equal('z', getopt_r(count(argv2), argv2, "xyz", &state2));
+  assert_equal(-1, getopt_r(count(argv1), argv1, "abc", &state1));
+  assert_equal(-1, getopt_r(count(argv2), argv2, "xyz", &state2));
+}
+
+TEST_F(getopt_fixture, test_getopt_long_r_interleaved_states) {
+  const char* argv1[] = {"foo.exe", "nonoption", "--first", "-s", "value"};
+  const char* argv2[] = {"bar.exe", "--second=other"};
+  getopt_state state1 = {0};
+  getopt_state state2 = {0};
+
+  option opts[] = {
+    {"first", no_argument, NULL, 'f'},
+    {"second", required_argument, NULL, 's'},
+    {0, 0, 0, 0}
+  };
+
+  assert_equal('f', getopt_long_r(count(argv1), argv1, "fs:", opts, NULL,
+    &state1));
+  assert_equal('s', getopt_long_r(count(argv2), argv2, "fs:", opts, NULL,
+    &state2));
+  assert_equal("other", state2.optarg);
+  assert_equal('s', getopt_long_r(count(argv1), argv1, "fs:", opts, NULL,
+    &state1));
+  assert_equal("value", state1.optarg);
+  assert_equal(-1, getopt_long_r(count(argv1), argv1, "fs:", opts, NULL,
+    &state1));
+  assert_equal(4, state1.optind);
+  assert_equal("nonoption", argv1[4]);
+  assert_equal(-1, getopt_long_r(count(argv2), argv2, "fs:", opts, NULL,
+    &state2));
+}
+
+TEST_F(getopt_fixture, test_getopt_r_reset) {
+  const char* argv[] = {"foo.exe", "-a"};
+  getopt_state state = {0};
+
+  assert_equal('a', getopt_r(count(argv), argv, "a", &state));
+  assert_equal(-1, getopt_r(count(argv), argv, "a", &state));
+
+  state.optind = 1;
+  assert_equal('a', getopt_r(count(argv), argv, "a", &state));
+}
+
+TEST_F(getopt_fixture, test_getopt_r_return_in_order) {
+  static const char* const argv[] = {"foo.exe", "in1", "-a", "in2", "-bx",
+                                     "--", "-a"};
+  getopt_state state = {0};
+  state.flags = GETOPT_RETURN_IN_ORDER;
+  const char** args = const_cast<const char**>(argv);
+
+  assert_equal(1, getopt_r(count(argv), args, "ab:", &state));
+  assert_equal("in1", state.optarg);
+  assert_equal(2, state.optind);
+  assert_equal('a', getopt_r(count(argv), args, "ab:", &state));
+  assert_equal(1, getopt_r(count(argv), args, "ab:", &state));
+  assert_equal("in2", state.optarg);
+  assert_equal(4, state.optind);
+  assert_equal('b', getopt_r(count(argv), args, "ab:", &state));
+  assert_equal("x", state.optarg);
+  assert_equal(-1, getopt_r(count(argv), args, "ab:", &state));
+  assert_equal(6, state.optind);
+
+  assert_equal("in1", argv[1]);
+  assert_equal("-a", argv[2]);
+  assert_equal("in2", argv[3]);
+}
+
+TEST_F(getopt_fixture, test_getopt_long_r_return_in_order) {
+  const char* argv[] = {"foo.exe", "--first", "in1", "--second", "in2",
+                        "in3"};
+  getopt_state state = {0};
+  state.flags = GETOPT_RETURN_IN_ORDER;
+
+  option opts[] = {
+    {"first", required_argument, NULL, 'f'},
+    {"second", no_argument, NULL, 's'},
+    {0, 0, 0, 0}
+  };
+
+  // A required argument is still taken from the next element.
+  assert_equal('f', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal("in1", state.optarg);
+  assert_equal('s', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(1, getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal("in2", state.optarg);
+  assert_equal(1, getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal("in3", state.optarg);
+  assert_equal(-1, getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(6, state.optind);
+}
+
+TEST_F(getopt_fixture, test_getopt_r_require_order) {
+  static const char* const argv[] = {"foo.exe", "-a", "in1", "-b", "x"};
+  getopt_state state = {0};
+  state.flags = GETOPT_REQUIRE_ORDER;
+  const char** args = const_cast<const char**>(argv);
+
+  assert_equal('a', getopt_r(count(argv), args, "ab:", &state));
+  assert_equal(-1, getopt_r(count(argv), args, "ab:", &state));
+  assert_equal(2, state.optind);
+  assert_equal("in1", argv[2]);
+}
+
+TEST_F(getopt_fixture, test_getopt_long_r_ordering_prefixes) {
+  const char* argv[] = {"foo.exe", "--first", "in1", "-b", "x", "-f"};
+  option opts[] = {
+    {"first", no_argument, NULL, 'f'},
+    {0, 0, 0, 0}
+  };
+  getopt_spec* spec = getopt_compile("+fb:", opts);
+  getopt_state state = {0};
+
+  // '+' stops at the first operand, leaving argv as it was.
+  assert_equal('f', getopt_long_r(count(argv), argv, "+fb:", opts, NULL,
+    &state));
+  assert_equal(-1, getopt_long_r(count(argv), argv, "+fb:", opts, NULL,
+    &state));
+  assert_equal(2, state.optind);
+  assert_equal("in1", argv[2]);
+
+  state.optind = 1;
+  assert_equal('f', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(-1, getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(2, state.optind);
+  assert_equal(0, getopt_spec_short(spec, '+'));
+
+  // '-' returns operands in place.
+  state.optind = 1;
+  assert_equal('f', getopt_long_r(count(argv), argv, "-fb:", opts, NULL,
+    &state));
+  assert_equal(1, getopt_long_r(count(argv), argv, "-fb:", opts, NULL,
+    &state));
+  assert_equal("in1", state.optarg);
+  assert_equal('b', getopt_long_r(count(argv), argv, "-fb:", opts, NULL,
+    &state));
+  assert_equal('f', getopt_long_r(count(argv), argv, "-fb:", opts, NULL,
+    &state));
+  assert_equal(-1, getopt_long_r(count(argv), argv, "-fb:", opts, NULL,
+    &state));
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_r_prefix_before_colon) {
+  const char* argv[] = {"foo.exe", "-b"};
+  getopt_state state = {0};
+
+  // The ':' after the prefix still selects ':' for a missing argument.
+  assert_equal(':', getopt_r(count(argv), argv, "+:b:", &state));
+  state.optind = 1;
+  assert_equal('?', getopt_r(count(argv), argv, "+b:", &state));
+}
+
+TEST_F(getopt_fixture, test_getopt_parse_require_order) {
+  const char* const argv[] = {"foo.exe", "-a", "in1", "-a"};
+  getopt_spec* spec = getopt_compile("+a", NULL);
+  getopt_record records[4];
+  int operands[4];
+  getopt_result result = {records, 4, 0, operands, 4, 0};
+
+  assert_equal(0, getopt_parse(count(argv), argv, spec, &result));
+  assert_equal(1, result.num_records);
+  assert_equal(2, result.num_operands);
+  assert_equal(2, operands[0]);
+  assert_equal(3, operands[1]);
+
+  getopt_spec_free(spec);
+}
+
+namespace {
+
+struct diagnostics {
+  int count;
+  getopt_diagnostic last;
+};
+
+void collect(void* context, const getopt_diagnostic* diagnostic) {
+  diagnostics* d = static_cast<diagnostics*>(context);
+  ++d->count;
+  d->last = *diagnostic;
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_r_diagnose_short) {
+  const char* argv[] = {"foo.exe", "-ax", "-b"};
+  diagnostics d = {0};
+  getopt_state state = {0};
+  state.diagnose = collect;
+  state.diagnose_context = &d;
+
+  assert_equal('a', getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal(0, d.count);
+  assert_equal('?', getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal(1, d.count);
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, d.last.error);
+  assert_equal(1, d.last.index);
+  assert_equal(0, d.last.longopt);
+  assert_equal('x', *d.last.option.data);
+  assert_equal("foo.exe", d.last.progname);
+  assert_equal('?', getopt_r(count(argv), argv, "ab:", &state));
+  assert_equal(2, d.count);
+  assert_equal(GETOPT_ERROR_MISSING_ARGUMENT, d.last.error);
+  assert_equal(2, d.last.index);
+  assert_equal('b', *d.last.option.data);
+}
+
+TEST_F(getopt_fixture, test_getopt_long_r_diagnose_long) {
+  const char* argv[] = {"foo.exe", "--fi=1", "--s", "--bogus", "--first"};
+  diagnostics d = {0};
+  getopt_state state = {0};
+  state.diagnose = collect;
+  state.diagnose_context = &d;
+
+  option opts[] = {
+    {"first", no_argument, NULL, 'f'},
+    {"second", no_argument, NULL, 's'},
+    {"silent", no_argument, NULL, 'S'},
+    {"value", required_argument, NULL, 'v'},
+    {0, 0, 0, 0}
+  };
+
+  assert_equal('?', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(GETOPT_ERROR_UNEXPECTED_ARGUMENT, d.last.error);
+  assert_equal(1, d.last.index);
+  assert_equal(1, d.last.longopt);
+  assert_equal(2, (int)d.last.option.length);
+  assert_equal('?', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(GETOPT_ERROR_AMBIGUOUS_OPTION, d.last.error);
+  assert_equal(2, d.last.num_matches);
+  assert_equal('?', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, d.last.error);
+  assert_equal(3, d.last.index);
+  assert_equal(5, (int)d.last.option.length);
+  assert_equal('f', getopt_long_r(count(argv), argv, "", opts, NULL, &state));
+  assert_equal(3, d.count);
+
+  const char* argv2[] = {"foo.exe", "--value"};
+  getopt_state state2 = {0};
+  state2.diagnose = collect;
+  state2.diagnose_context = &d;
+  assert_equal(':', getopt_long_r(count(argv2), argv2, "", opts, NULL,
+    &state2));
+  assert_equal(GETOPT_ERROR_MISSING_ARGUMENT, d.last.error);
+  assert_equal(1, d.last.index);
+}
@@ -0,0 +1,211 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <string>
+#include <vector>
+
+static const option spec_opts[] = {
+  {"error", optional_argument, NULL, 'e'},
+  {"error_always", optional_argument, NULL, 'a'},
+  {"first", no_argument, NULL, '1'},
+  {"fifth", required_argument, NULL, '5'},
+  {"second", no_argument, NULL, '2'},
+  {0, 0, 0, 0}
+};
+
+static int lookup(const getopt_spec* spec, const char* name, int* matches) {
+  return getopt_spec_lookup(spec, name, strlen(name), matches);
+}
+
+TEST_F(getopt_fixture, test_getopt_spec_lookup) {
+  getopt_spec* spec = getopt_compile("", spec_opts);
+  int matches = -1;
+
+  assert_equal(2, lookup(spec, "first", &matches));
+  assert_equal(1, matches);
+  assert_equal(2, lookup(spec, "fir", &matches));
+  assert_equal(3, lookup(spec, "fif", &matches));
+  assert_equal(4, lookup(spec, "s", &matches));
+
+  // Ambiguous abbreviation.
+  assert_equal(-1, lookup(spec, "fi", &matches));
+  assert_equal(2, matches);
+
+  // Exact match wins over a longer name with the same prefix.
+  assert_equal(0, lookup(spec, "error", &matches));
+  assert_equal(1, matches);
+  assert_equal(1, lookup(spec, "error_", &matches));
+
+  assert_equal(-1, lookup(spec, "third", &matches));
+  assert_equal(0, matches);
+  assert_equal(-1, lookup(spec, "firstly", &matches));
+  assert_equal(0, matches);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_spec_lookup_duplicates) {
+  const option opts[] = {
+    {"dup", no_argument, NULL, 'x'},
+    {"dup", no_argument, NULL, 'y'},
+    {0, 0, 0, 0}
+  };
+  getopt_spec* spec = getopt_compile("", opts);
+  int matches = -1;
+
+  // The first of several identical names wins, as with getopt_long().
+  assert_equal(0, lookup(spec, "dup", &matches));
+  assert_equal(-1, lookup(spec, "du", &matches));
+  assert_equal(2, matches);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_compiled_long) {
+  const char* argv[] = {"foo.exe", "--fir", "operand", "--fif=5", "-2",
+                        "--error", "--fi"};
+  getopt_spec* spec = getopt_compile("12e::a::5:", spec_opts);
+  int longindex = -1;
+
+  assert_equal('1', getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal(2, longindex);
+  assert_equal('5', getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal("5", optarg);
+  assert_equal('2', getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal('e', getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal('?', getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal(-1, getopt_compiled(count(argv), argv, spec, &longindex));
+  assert_equal("operand", argv[optind]);
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_compiled_without_longopts) {
+  // Without long options, "--fo" is a cluster of short options, as with
+  // getopt().
+  const char* argv[] = {"foo.exe", "--fo"};
+  getopt_spec* spec = getopt_compile("fo-", NULL);
+  getopt_state state = {0};
+
+  assert_equal('-', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal('f', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal('o', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(-1, getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_compiled_matches_scan) {
+  // Resolve every prefix of every name in a larger table and compare with
+  // the linear scan done by getopt_long().
+  std::vector<std::string> names;
+  for (int i = 0; i < 300; ++i) {
+    char name[32];
+    sprintf(name, "opt%c%d-%s", 'a' + i % 7, i % 13, i % 2 ? "x" : "long");
+    names.push_back(name);
+  }
+
+  std::vector<option> opts;
+  for (size_t i = 0; i < names.size(); ++i) {
+    option o = {names[i].c_str(), no_argument, NULL, (int)i + 1000};
+    opts.push_back(o);
+  }
+  option end = {0, 0, 0, 0};
+  opts.push_back(end);
+
+  getopt_spec* spec = getopt_compile("", &opts[0]);
+  for (size_t i = 0; i < names.size(); ++i) {
+    for (size_t length = 1; length <= names[i].size(); ++length) {
+      std::string arg = "--" + names[i].substr(0, length);
+      const char* argv[] = {"foo.exe", arg.c_str()};
+      getopt_state scanned = {0};
+      getopt_state compiled = {0};
+      int scanned_index = -1;
+      int compiled_index = -1;
+
+      assert_equal(getopt_long_r(count(argv), argv, "", &opts[0],
+                                 &scanned_index, &scanned),
+                   getopt_compiled_r(count(argv), argv, spec,
+                                     &compiled_index, &compiled));
+      assert_equal(scanned_index, compiled_index);
+    }
+  }
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_spec_short) {
+  getopt_spec* spec = getopt_compile("ab:c::b", NULL);
+
+  assert_equal(no_argument, getopt_spec_short(spec, 'a'));
+  assert_equal(required_argument, getopt_spec_short(spec, 'b'));
+  assert_equal(optional_argument, getopt_spec_short(spec, 'c'));
+  assert_equal(0, getopt_spec_short(spec, 'd'));
+  assert_equal(0, getopt_spec_short(spec, '\xe9'));
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_compiled_short) {
+  const char* argv[] = {"foo.exe", "-abvalue", "-cx", "-c", "-d", "-b"};
+  getopt_spec* spec = getopt_compile(":ab:c::", NULL);
+
+  assert_equal('a', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal('b', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal("value", optarg);
+  assert_equal('c', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal("x", optarg);
+  assert_equal('c', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal((char*)NULL, optarg);
+  assert_equal('?', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal('d', optopt);
+  assert_equal(':', getopt_compiled(count(argv), argv, spec, NULL));
+  assert_equal('b', optopt);
+  assert_equal(-1, getopt_compiled(count(argv), argv, spec, NULL));
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_compiled_long_with_short_table) {
+  const char* argv[] = {"foo.exe", "-5", "500", "-12", "--second"};
+  getopt_spec* spec = getopt_compile("12e::a::5:", spec_opts);
+  getopt_state state = {0};
+
+  assert_equal('5', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal("500", state.optarg);
+  assert_equal('1', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal('2', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal('2', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(-1, getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+
+  getopt_spec_free(spec);
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Splits line into a fresh buffer, returning the arguments, or "<error>".
+std::vector<std::string> split(const std::string& line, int rules) {
+  std::vector<char> buffer(line.size() + 1);
+  const char* argv[32];
+  int argc = getopt_split(line.data(), line.size(), rules, &buffer[0], argv,
+    32);
+
+  if (argc < 0)
+    return std::vector<std::string>(1, "<error>");
+  return std::vector<std::string>(argv, argv + argc);
+}
+
+void assert_split(const std::vector<std::string>& expected,
+                  const std::vector<std::string>& actual) {
+  assert_equal(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+    assert_equal(expected[i], actual[i]);
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_split_posix) {
+  assert_split({"prog", "-a", "b c", "d \"e\" $f \\g", "h i", "jk", ""},
+    split("  prog\t-a 'b c' \"d \\\"e\\\" \\$f \\g\" h\\ i  j\\\nk ''\n",
+          GETOPT_SPLIT_POSIX));
+  assert_split({"a'b", "c\"d"}, split("\"a'b\" 'c\"d'", GETOPT_SPLIT_POSIX));
+  assert_split({"x\\"}, split("x\\", GETOPT_SPLIT_POSIX));
+  assert_split({}, split(" \t\n ", GETOPT_SPLIT_POSIX));
+  assert_split({"<error>"}, split("prog 'open", GETOPT_SPLIT_POSIX));
+  assert_split({"<error>"}, split("prog \"open", GETOPT_SPLIT_POSIX));
+}
+
+TEST_F(getopt_fixture, test_getopt_split_windows) {
+  assert_split({"C:\\Program Files\\x.exe", "a\\\"b", "c d", "e\\\\f g",
+                "hi", "j\"k", "\\\\server\\share", ""},
+    split("\"C:\\Program Files\\x.exe\" a\\\\\\\"b \"c d\" e\\\\\\\\\"f g\" "
+          "h\"\"i \"j\"\"k\" \\\\server\\share \"\"", GETOPT_SPLIT_WINDOWS));
+  // The program name takes backslashes literally, and quotes only group.
+  assert_split({"a\\b c", "d"}, split("a\\\"b c\" d", GETOPT_SPLIT_WINDOWS));
+  assert_split({"prog", "'a", "b'", "c\nd"},
+    split("prog 'a b' c\nd", GETOPT_SPLIT_WINDOWS));
+  assert_split({"prog", "open end"}, split("prog \"open end",
+    GETOPT_SPLIT_WINDOWS));
+  assert_split({""}, split("\"\"", GETOPT_SPLIT_WINDOWS));
+}
+
+TEST_F(getopt_fixture, test_getopt_split_long_arguments) {
+  // Runs longer than a vector, with the special bytes at every offset.
+  for (size_t offset = 0; offset < 40; ++offset) {
+    std::string a(offset, 'a');
+    std::string b(40 - offset, 'b');
+    std::string high = "\xc3\xa9" + b;
+
+    assert_split({a + "x", b}, split(a + "x\x0b" + b, GETOPT_SPLIT_POSIX));
+    assert_split({a + " " + b}, split("'" + a + " " + b + "'",
+      GETOPT_SPLIT_POSIX));
+    assert_split({a + "\"" + b}, split(a + "\\\"" + b, GETOPT_SPLIT_POSIX));
+    assert_split({"p", a + "\\" + b}, split("p " + a + "\\" + b,
+      GETOPT_SPLIT_WINDOWS));
+    assert_split({a + high}, split(a + high, GETOPT_SPLIT_POSIX));
+  }
+}
+
+TEST_F(getopt_fixture, test_getopt_split_in_place_into_parser) {
+  char line[] = "prog -vo 'out file' in1 --level=\"3\"";
+  option opts[] = {
+    {"level", required_argument, NULL, 'l'},
+    {0, 0, 0, 0}
+  };
+  const char* argv[8];
+  getopt_state state = {0};
+  int argc = getopt_split(line, strlen(line), GETOPT_SPLIT_POSIX, line, argv,
+    8);
+
+  assert_equal(5, argc);
+  assert_equal(true, argv[5] == NULL);
+  assert_equal('v', getopt_long_r(argc, argv, "vo:", opts, NULL, &state));
+  assert_equal('o', getopt_long_r(argc, argv, "vo:", opts, NULL, &state));
+  assert_equal("out file", state.optarg);
+  assert_equal('l', getopt_long_r(argc, argv, "vo:", opts, NULL, &state));
+  assert_equal("3", state.optarg);
+  assert_equal(-1, getopt_long_r(argc, argv, "vo:", opts, NULL, &state));
+  assert_equal("in1", argv[state.optind]);
+}
+
+TEST_F(getopt_fixture, test_getopt_split_windows_in_place) {
+  const char* lines[] = {"prog -a \"b c\"", "\"C:\\Program Files\\p.exe\" -a",
+                         "prog", "  prog  "};
+  const char* expected[][3] = {{"prog", "-a", "b c"},
+                               {"C:\\Program Files\\p.exe", "-a", NULL},
+                               {"prog", NULL, NULL},
+                               {"prog", NULL, NULL}};
+
+  for (size_t i = 0; i < count(lines); ++i) {
+    // Exactly as long as the line and its terminator, on the heap.
+    size_t length = strlen(lines[i]);
+    std::vector<char> line(lines[i], lines[i] + length + 1);
+    const char* argv[4];
+    int argc = getopt_split(&line[0], length, GETOPT_SPLIT_WINDOWS, &line[0],
+      argv, 4);
+
+    int n = 0;
+    while (n < 3 && expected[i][n] != NULL)
+      ++n;
+    assert_equal(n, argc);
+    assert_equal(true, argv[argc] == NULL);
+    for (int j = 0; j < argc; ++j)
+      assert_equal(std::string(expected[i][j]), std::string(argv[j]));
+  }
+}
+
+TEST_F(getopt_fixture, test_getopt_split_max_args) {
+  const char line[] = "a b c";
+  char buffer[sizeof(line)];
+  const char* argv[2];
+
+  assert_equal(3, getopt_split(line, strlen(line), GETOPT_SPLIT_POSIX, buffer,
+    argv, 2));
+  assert_equal("a", argv[0]);
+  assert_equal("b", argv[1]);
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+// Built into test_getopt_port_instrumented, with GETOPT_INSTRUMENT.
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <vector>
+
+namespace {
+
+struct event {
+  int type;
+  int index;
+  unsigned long value;
+};
+
+void record_event(void* context, int type, int index, unsigned long value) {
+  event e = {type, index, value};
+  static_cast<std::vector<event>*>(context)->push_back(e);
+}
+
+option stats_opts[] = {
+  {"alpha", no_argument, NULL, 'a'},
+  {"beta", no_argument, NULL, 'b'},
+  {"bravo", required_argument, NULL, 'B'},
+  {0, 0, 0, 0}
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_stats_permutation) {
+  const char* argv[] = {"foo.exe", "x", "y", "-a", "z", "-b"};
+  getopt_stats stats = {0};
+  std::vector<event> events;
+  getopt_state state = {0};
+  state.stats = &stats;
+  state.trace = record_event;
+  state.trace_context = &events;
+
+  while (getopt_r(count(argv), argv, "ab", &state) != -1) {
+  }
+
+  assert_equal(2, (int)stats.exchanges);
+  assert_equal(2, (int)events.size());
+  assert_equal(GETOPT_TRACE_EXCHANGE, events[0].type);
+  assert_equal(stats.moves, events[0].value + events[1].value);
+  assert_equal("-a", argv[1]);
+  assert_equal("-b", argv[2]);
+}
+
+TEST_F(getopt_fixture, test_getopt_stats_lookups_and_errors) {
+  const char* argv[] = {"foo.exe", "--alpha", "--br=1", "--b", "--bogus",
+                        "-q", "--bravo"};
+  getopt_stats stats = {0};
+  getopt_state state = {0};
+  state.stats = &stats;
+
+  while (getopt_long_r(count(argv), argv, "a", stats_opts, NULL, &state)
+         != -1) {
+  }
+
+  assert_equal(5, (int)stats.lookups);
+  assert_equal(1, (int)stats.abbreviations);
+  // --alpha is found first, the others are compared with every option.
+  assert_equal(1 + 3 + 3 + 3 + 3, (int)stats.comparisons);
+  assert_equal(2, (int)stats.errors[GETOPT_ERROR_UNKNOWN_OPTION]);
+  assert_equal(1, (int)stats.errors[GETOPT_ERROR_AMBIGUOUS_OPTION]);
+  assert_equal(1, (int)stats.errors[GETOPT_ERROR_MISSING_ARGUMENT]);
+}
+
+TEST_F(getopt_fixture, test_getopt_stats_compiled_lookups) {
+  const char* argv[] = {"foo.exe", "--bravo=1", "--al"};
+  getopt_spec* spec = getopt_compile("", stats_opts);
+  getopt_stats stats = {0};
+  getopt_state state = {0};
+  state.stats = &stats;
+
+  while (getopt_compiled_r(count(argv), argv, spec, NULL, &state) != -1) {
+  }
+
+  assert_equal(2, (int)stats.lookups);
+  assert_equal(1, (int)stats.abbreviations);
+  assert_equal(true, stats.comparisons >= 7);
+
+  getopt_spec_free(spec);
+}
@@ -0,0 +1,352 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <string.h>
+#include <string>
+
+namespace {
+
+// Serves a string a few bytes at a time, to split arguments across reads.
+struct string_reader {
+  const char* text;
+  int chunk;
+};
+
+int read_string(void* context, char* buffer, int size) {
+  string_reader* reader = static_cast<string_reader*>(context);
+  int n = (int)strlen(reader->text);
+
+  if (n > reader->chunk)
+    n = reader->chunk;
+  if (n > size)
+    n = size;
+  memcpy(buffer, reader->text, n);
+  reader->text += n;
+  return n;
+}
+
+option stream_opts[] = {
+  {"define", required_argument, NULL, 'D'},
+  {"verbose", no_argument, NULL, 'v'},
+  {0, 0, 0, 0}
+};
+
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_options_and_operands) {
+  string_reader reader = {
+    "  -vD x\n--define=y  in1\t--verb -D\n  z -- -v\n", 3};
+  getopt_spec* spec = getopt_compile("vD:", stream_opts);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+
+  assert_equal('v', getopt_stream_next(stream, NULL, &state));
+  assert_equal(1, state.optind);
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("x", state.optarg);
+  assert_equal(3, state.optind);
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("y", state.optarg);
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("in1", state.optarg);
+  assert_equal('v', getopt_stream_next(stream, NULL, &state));
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("z", state.optarg);
+  assert_equal(1, (int)state.optvalue.length);
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("-v", state.optarg);
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+  assert_equal(10, state.optind);
+  assert_equal(0, getopt_stream_error(stream));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_cluster_then_refill) {
+  // A flag followed by two more arguments, read whole and a byte at a time,
+  // so that the buffer of the finished "-a" is refilled with later ones.
+  const int chunks[] = {64, 1};
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+    string_reader reader = {"-a bcd efgh", chunks[i]};
+    getopt_spec* spec = getopt_compile("agh", NULL);
+    getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+    getopt_state state = {0};
+
+    assert_equal('a', getopt_stream_next(stream, NULL, &state));
+    assert_equal(1, getopt_stream_next(stream, NULL, &state));
+    assert_equal("bcd", state.optarg);
+    assert_equal(1, getopt_stream_next(stream, NULL, &state));
+    assert_equal("efgh", state.optarg);
+    assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+    getopt_stream_free(stream);
+    getopt_spec_free(spec);
+  }
+
+  // A cluster ending at a chunk boundary, followed by longer arguments.
+  string_reader reader = {"-gh abcdefgh -a", 3};
+  getopt_spec* spec = getopt_compile("agh", NULL);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+
+  assert_equal('g', getopt_stream_next(stream, NULL, &state));
+  assert_equal('h', getopt_stream_next(stream, NULL, &state));
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("abcdefgh", state.optarg);
+  assert_equal('a', getopt_stream_next(stream, NULL, &state));
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+  assert_equal(4, state.optind);
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_quoting) {
+  string_reader reader = {
+    "'a b'c \"d \\\"e\\\" \\n\" f\\ g '' -D'it''s'", 5};
+  getopt_spec* spec = getopt_compile("D:", NULL);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("a bc", state.optarg);
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("d \"e\" \\n", state.optarg);
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("f g", state.optarg);
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("", state.optarg);
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("its", state.optarg);
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_split_rules) {
+  // A response file reads the same as getopt_split() makes of it with the
+  // POSIX rules. After the leading "--", every argument is an operand.
+  const char* texts[] = {
+    "-- a\\$b \"a\\$b\" 'a\\$b' \"a\\`b\" \"e\\f\" g\\ h \"i\\\"j\" \"k\\\\\"",
+    "-- c\\\nd \"c\\\nd\" 'c\\\nd' \\\n x y\\",
+    "-- \"\" '' \"'\" '\"' \\' \\\" m\"n o\"'p q'",
+  };
+  const int chunks[] = {64, 1};
+
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+    std::string buffer(strlen(texts[i]) + 1, '\0');
+    const char* argv[16];
+    int argc = getopt_split(texts[i], strlen(texts[i]), GETOPT_SPLIT_POSIX,
+      &buffer[0], argv, (int)count(argv));
+    assert_equal(true, argc > 1 && argc <= (int)count(argv));
+
+    for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); ++j) {
+      string_reader reader = {texts[i], chunks[j]};
+      getopt_spec* spec = getopt_compile("", NULL);
+      getopt_stream* stream = getopt_stream_create(read_string, &reader,
+        spec);
+      getopt_state state = {0};
+
+      for (int k = 1; k < argc; ++k) {
+        assert_equal(1, getopt_stream_next(stream, NULL, &state));
+        assert_equal(argv[k], state.optarg);
+      }
+      assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+      getopt_stream_free(stream);
+      getopt_spec_free(spec);
+    }
+  }
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_long_argument) {
+  // Arguments longer than the read buffer are assembled across reads.
+  std::string text = "-D ";
+  text.append(10000, 'x');
+  string_reader reader = {text.c_str(), 4096};
+  getopt_spec* spec = getopt_compile("D:", NULL);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal(10000, (int)strlen(state.optarg));
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_missing_argument) {
+  string_reader reader = {"-v -D", 64};
+  getopt_spec* spec = getopt_compile("vD:", NULL);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+
+  assert_equal('v', getopt_stream_next(stream, NULL, &state));
+  assert_equal('?', getopt_stream_next(stream, NULL, &state));
+  assert_equal('D', state.optopt);
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+  assert_equal(3, state.optind);
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_open_missing_file) {
+  getopt_spec* spec = getopt_compile("v", NULL);
+
+  assert_equal(true, getopt_stream_open("no/such/response/file", spec) == NULL);
+
+  getopt_spec_free(spec);
+}
+
+namespace {
+
+void count_diagnostic(void* context, const getopt_diagnostic* diagnostic) {
+  *static_cast<int*>(context) = diagnostic->index;
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_diagnostic_index) {
+  string_reader reader = {"a b -x", 64};
+  getopt_spec* spec = getopt_compile("v", NULL);
+  getopt_stream* stream = getopt_stream_create(read_string, &reader, spec);
+  getopt_state state = {0};
+  int index = 0;
+  state.diagnose = count_diagnostic;
+  state.diagnose_context = &index;
+
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal('?', getopt_stream_next(stream, NULL, &state));
+  assert_equal(3, index);
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+namespace {
+
+int push(getopt_stream* stream, const char* arg) {
+  return getopt_stream_push(stream, arg, strlen(arg));
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_push) {
+  getopt_spec* spec = getopt_compile("vD:", stream_opts);
+  getopt_stream* stream = getopt_stream_create(NULL, NULL, spec);
+  getopt_state state = {0};
+
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "-vD"));
+  assert_equal('v', getopt_stream_next(stream, NULL, &state));
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "x"));
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("x", state.optarg);
+  assert_equal(3, state.optind);
+
+  assert_equal(0, push(stream, "--define"));
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "y"));
+  assert_equal(-1, push(stream, "z"));
+  assert_equal('D', getopt_stream_next(stream, NULL, &state));
+  assert_equal("y", state.optarg);
+
+  assert_equal(0, push(stream, "--verb"));
+  assert_equal('v', getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "--"));
+  assert_equal(0, push(stream, "-v"));
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("-v", state.optarg);
+  assert_equal(8, state.optind);
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+
+  getopt_stream_end(stream);
+  assert_equal(-1, push(stream, "in"));
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, getopt_stream_error(stream));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_push_after_cluster) {
+  // Each argument is pushed once the previous one has been parsed, into
+  // the buffer of a finished cluster.
+  getopt_spec* spec = getopt_compile("az", NULL);
+  getopt_stream* stream = getopt_stream_create(NULL, NULL, spec);
+  getopt_state state = {0};
+
+  assert_equal(0, push(stream, "-a"));
+  assert_equal('a', getopt_stream_next(stream, NULL, &state));
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "xyz"));
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("xyz", state.optarg);
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "-za"));
+  assert_equal('z', getopt_stream_next(stream, NULL, &state));
+  assert_equal('a', getopt_stream_next(stream, NULL, &state));
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  assert_equal(0, push(stream, "bcd"));
+  assert_equal(1, getopt_stream_next(stream, NULL, &state));
+  assert_equal("bcd", state.optarg);
+  assert_equal(5, state.optind);
+
+  getopt_stream_end(stream);
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_stream_push_missing_argument) {
+  getopt_spec* spec = getopt_compile(":vD:", stream_opts);
+  getopt_stream* stream = getopt_stream_create(NULL, NULL, spec);
+  getopt_state state = {0};
+
+  assert_equal(0, push(stream, "-D"));
+  assert_equal(GETOPT_PENDING, getopt_stream_next(stream, NULL, &state));
+  getopt_stream_end(stream);
+  assert_equal(':', getopt_stream_next(stream, NULL, &state));
+  assert_equal('D', state.optopt);
+  assert_equal(-1, getopt_stream_next(stream, NULL, &state));
+
+  getopt_stream_free(stream);
+  getopt_spec_free(spec);
+}
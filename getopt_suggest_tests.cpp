@@ -0,0 +1,178 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+const option suggest_opts[] = {
+  {"verbose", no_argument, NULL, 'v'},
+  {"version", no_argument, NULL, 'V'},
+  {"output", required_argument, NULL, 'o'},
+  {"input", required_argument, NULL, 'i'},
+  {"dry-run", no_argument, NULL, 'n'},
+  {0, 0, 0, 0}
+};
+
+struct captured {
+  int error;
+  const char* suggestion;
+};
+
+void capture(void* context, const getopt_diagnostic* diagnostic) {
+  captured* c = static_cast<captured*>(context);
+  c->error = diagnostic->error;
+  c->suggestion = diagnostic->suggestion;
+}
+
+// The textbook dynamic programming distance, to check against.
+int levenshtein(const std::string& a, const std::string& b) {
+  std::vector<int> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j)
+    row[j] = (int)j;
+  for (size_t i = 1; i <= a.size(); ++i) {
+    int diagonal = row[0];
+    row[0] = (int)i;
+    for (size_t j = 1; j <= b.size(); ++j) {
+      int above = row[j];
+      row[j] = std::min(std::min(row[j] + 1, row[j - 1] + 1),
+        diagonal + (a[i - 1] == b[j - 1] ? 0 : 1));
+      diagonal = above;
+    }
+  }
+  return row[b.size()];
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_suggest) {
+  int indices[GETOPT_MAX_SUGGESTIONS];
+
+  assert_equal(2, getopt_suggest(suggest_opts, "versoin", 7, 3, indices, 4));
+  assert_equal(1, indices[0]);  // a transposition is two edits
+  assert_equal(0, indices[1]);
+
+  // Equally close names keep their table order.
+  assert_equal(2, getopt_suggest(suggest_opts, "verbon", 6, 2, indices, 4));
+  assert_equal(0, indices[0]);
+  assert_equal(1, indices[1]);
+  assert_equal(1, getopt_suggest(suggest_opts, "verbon", 6, 2, indices, 1));
+  assert_equal(0, indices[0]);
+
+  // Insertions and deletions, and the length bounds the name.
+  assert_equal(1, getopt_suggest(suggest_opts, "ouput", 5, 1, indices, 4));
+  assert_equal(2, indices[0]);
+  assert_equal(1, getopt_suggest(suggest_opts, "inputs", 6, 1, indices, 4));
+  assert_equal(3, indices[0]);
+  assert_equal(1, getopt_suggest(suggest_opts, "dry-runner", 7, 0, indices,
+    4));
+  assert_equal(4, indices[0]);
+
+  assert_equal(0, getopt_suggest(suggest_opts, "frobnicate", 10, 3, indices,
+    4));
+  assert_equal(0, getopt_suggest(suggest_opts, "", 0, 3, indices, 4));
+}
+
+TEST_F(getopt_fixture, test_getopt_suggest_matches_levenshtein) {
+  // Many similar names, so that most are near each typo.
+  std::vector<std::string> names;
+  std::vector<option> options;
+  char buf[32];
+  for (int i = 0; i < 2000; ++i) {
+    sprintf(buf, "opt-%c%c-%d", 'a' + i % 26, 'a' + i / 26 % 26, i % 7);
+    names.push_back(buf);
+  }
+  for (size_t i = 0; i < names.size(); ++i) {
+    option o = {names[i].c_str(), no_argument, NULL, 0};
+    options.push_back(o);
+  }
+  option end = {0, 0, 0, 0};
+  options.push_back(end);
+
+  const char* typos[] = {"opt-ab-3", "otp-qz-1", "opt-zz", "op-mn-44",
+                         "xopt-cd-0", "opt-a-b-c-d"};
+  for (size_t t = 0; t < count(typos); ++t) {
+    for (int max_distance = 0; max_distance <= 3; ++max_distance) {
+      int indices[GETOPT_MAX_SUGGESTIONS];
+      int found = getopt_suggest(&options[0], typos[t], strlen(typos[t]),
+        max_distance, indices, GETOPT_MAX_SUGGESTIONS);
+
+      // The reference: every name in range, by distance then index.
+      std::vector<std::pair<int, int> > expected;
+      for (size_t i = 0; i < names.size(); ++i) {
+        int d = levenshtein(typos[t], names[i]);
+        if (d <= max_distance)
+          expected.push_back(std::make_pair(d, (int)i));
+      }
+      std::sort(expected.begin(), expected.end());
+      if (expected.size() > GETOPT_MAX_SUGGESTIONS)
+        expected.resize(GETOPT_MAX_SUGGESTIONS);
+
+      assert_equal(expected.size(), (size_t)found);
+      for (int i = 0; i < found; ++i)
+        assert_equal(expected[i].second, indices[i]);
+    }
+  }
+}
+
+TEST_F(getopt_fixture, test_getopt_long_suggestion) {
+  const char* argv[] = {"foo", "--outptu", "x", "--verbsoe=1", "--ver",
+                        "--zz"};
+  getopt_spec* spec = getopt_compile("", suggest_opts);
+  captured c = {0, NULL};
+  getopt_state state = {0};
+  state.diagnose = capture;
+  state.diagnose_context = &c;
+
+  // An unknown option gets the closest name, when it is close enough.
+  assert_equal('?', getopt_long_r(count(argv), argv, "", suggest_opts, NULL,
+    &state));
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, c.error);
+  assert_equal(std::string("output"), std::string(c.suggestion));
+
+  // Only for unknown options, by the name without its argument.
+  state.optind = 3;
+  assert_equal('?', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(std::string("verbose"), std::string(c.suggestion));
+  assert_equal('?', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(GETOPT_ERROR_AMBIGUOUS_OPTION, c.error);
+  assert_equal(true, c.suggestion == NULL);
+  assert_equal('?', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(GETOPT_ERROR_UNKNOWN_OPTION, c.error);
+  assert_equal(true, c.suggestion == NULL);
+
+  getopt_spec_free(spec);
+}
@@ -30,6 +30,8 @@
 #include "testfx.h"
 #include "testsupport.h"
 
+#include <stdlib.h>
+
 TEST_F(getopt_fixture, test_getopt_empty) {
   const char* argv[] = {"foo.exe"};
   assert_equal(-1, getopt(count(argv), argv, "abc"));
@@ -74,10 +76,12 @@ TEST_F(getopt_fixture, test_getopt_embedded_nonoptions) {
 
   // The non-option argument "nonoption1" DOES NOT terminate the scan: 
   // we follow GNU getopt behaviour where the argv elements get reshuffled
-  // as a side-effect.
+  // as a side-effect, once the options following them have been seen.
   assert_equal('b', getopt(count(argv), argv, "ab"));
   assert_equal('b', optopt);
   assert_equal((char*)NULL, optarg);
+  assert_equal(-1, getopt(count(argv), argv, "ab"));
+  assert_equal(3, optind);
   assert_equal("-b", argv[2]);
   assert_equal("nonoption1", argv[3]);
   assert_equal("nonoption2", argv[4]);
@@ -100,6 +104,65 @@ TEST_F(getopt_fixture, test_getopt_stop_scan_on_double_dash) {
 	assert_equal("-b", argv[5]);
 }
 
+TEST_F(getopt_fixture, test_getopt_nonoption_runs_keep_order) {
+  const char* argv[] = {"foo.exe", "n1", "n2", "-a", "n3", "-b", "value",
+                        "n4", "-c"};
+  assert_equal('a', getopt(count(argv), argv, "ab:c"));
+  assert_equal('b', getopt(count(argv), argv, "ab:c"));
+  assert_equal("value", optarg);
+  assert_equal('c', getopt(count(argv), argv, "ab:c"));
+  assert_equal(-1, getopt(count(argv), argv, "ab:c"));
+
+  assert_equal(5, optind);
+  assert_equal("-a", argv[1]);
+  assert_equal("-b", argv[2]);
+  assert_equal("value", argv[3]);
+  assert_equal("-c", argv[4]);
+  assert_equal("n1", argv[5]);
+  assert_equal("n2", argv[6]);
+  assert_equal("n3", argv[7]);
+  assert_equal("n4", argv[8]);
+}
+
+TEST_F(getopt_fixture, test_getopt_nonoptions_before_single_dash) {
+  const char* argv[] = {"foo.exe", "n1", "-a", "-", "n2"};
+  assert_equal('a', getopt(count(argv), argv, "a"));
+  assert_equal(-1, getopt(count(argv), argv, "a"));
+
+  assert_equal(2, optind);
+  assert_equal("n1", argv[2]);
+  assert_equal("-", argv[3]);
+  assert_equal("n2", argv[4]);
+}
+
+TEST_F(getopt_fixture, test_getopt_new_scan_past_start) {
+  // A scan may start past argv[1], e.g. after a subcommand; nothing before
+  // optind is moved, whatever the previous scan left behind.
+  const char* first[] = {"foo.exe", "n1", "-a"};
+  const char* argv[] = {"foo.exe", "q", "r", "-b", "s"};
+  assert_equal('a', getopt(count(first), first, "ab"));
+  assert_equal(-1, getopt(count(first), first, "ab"));
+  assert_equal(2, optind);
+
+  optind = 3;
+  assert_equal('b', getopt(count(argv), argv, "ab"));
+  assert_equal(-1, getopt(count(argv), argv, "ab"));
+  assert_equal(4, optind);
+  assert_equal("q", argv[1]);
+  assert_equal("r", argv[2]);
+  assert_equal("-b", argv[3]);
+  assert_equal("s", argv[4]);
+}
+
+TEST_F(getopt_fixture, test_getopt_missing_argument_after_nonoption) {
+  // A skipped non-option must not be taken as the option-argument.
+  const char* argv[] = {"foo.exe", "nonoption", "-a"};
+  assert_equal('?', getopt(count(argv), argv, "a:"));
+  assert_equal((char*)NULL, optarg);
+  assert_equal(-1, getopt(count(argv), argv, "a:"));
+  assert_equal("nonoption", argv[optind]);
+}
+
 TEST_F(getopt_fixture, test_getopt_argument_same_argv) {
   const char* argv[] = {"foo.exe", "-aargument"};
 
@@ -157,3 +220,23 @@ TEST_F(getopt_fixture, test_getopt_optopt) {
   assert_equal('?', getopt(count(argv), argv, "a"));
   assert_equal('b', optopt);
 }
+
+#if !defined(_WIN32)
+TEST_F(getopt_fixture, test_getopt_posixly_correct) {
+  const char* argv[] = {"foo.exe", "-a", "in1", "-b"};
+
+  setenv("POSIXLY_CORRECT", "1", 1);
+  assert_equal('a', getopt(count(argv), argv, "ab"));
+  assert_equal(-1, getopt(count(argv), argv, "ab"));
+  assert_equal(2, optind);
+  unsetenv("POSIXLY_CORRECT");
+
+  // Without it, the next scan permutes again.
+  optind = 1;
+  assert_equal('a', getopt(count(argv), argv, "ab"));
+  assert_equal('b', getopt(count(argv), argv, "ab"));
+  assert_equal(-1, getopt(count(argv), argv, "ab"));
+  assert_equal(3, optind);
+  assert_equal("in1", argv[3]);
+}
+#endif
@@ -0,0 +1,275 @@
+/*******************************************************************************
+ * Copyright (c) 2012-2023, Kim Gräsman <kim.grasman@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Kim Gräsman nor the
+ *     names of contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL KIM GRÄSMAN BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************/
+
+#include "getopt.h"
+#include "testfx.h"
+#include "testsupport.h"
+
+#include <limits.h>
+#include <locale.h>
+#include <string.h>
+#include <string>
+
+namespace {
+
+const option value_opts[] = {
+  {"jobs", required_argument, NULL, 'j'},
+  {"ratio", required_argument, NULL, 'r'},
+  {"cache", required_argument, NULL, 'c'},
+  {"timeout", required_argument, NULL, 't'},
+  {"color", optional_argument, NULL, 'C'},
+  {0, 0, 0, 0}
+};
+
+const char* const colors[] = {"never", "auto", "always", NULL};
+
+struct values {
+  long long jobs;
+  double ratio;
+  unsigned long long cache;
+  long long timeout;
+  int color;
+  getopt_keywords* color_keywords;
+  getopt_value table[6];
+
+  values() : jobs(0), ratio(0), cache(0), timeout(0), color(-1),
+    color_keywords(getopt_keywords_compile(colors)) {
+    getopt_value t[] = {
+      {'j', GETOPT_TYPE_INT, &jobs, 1, 64, NULL},
+      {'r', GETOPT_TYPE_DOUBLE, &ratio, 0, 0, NULL},
+      {'c', GETOPT_TYPE_SIZE, &cache, 0, 0, NULL},
+      {'t', GETOPT_TYPE_DURATION, &timeout, 0, 0, NULL},
+      {'C', GETOPT_TYPE_ENUM, &color, 0, 0, color_keywords},
+      {0, 0, NULL, 0, 0, NULL}
+    };
+    memcpy(table, t, sizeof(t));
+  }
+
+  ~values() {
+    getopt_keywords_free(color_keywords);
+  }
+};
+
+struct diagnostic_record {
+  int error;
+  int index;
+  std::string value;
+  const char* const* keywords;
+};
+
+void record_diagnostic(void* context, const getopt_diagnostic* diagnostic) {
+  diagnostic_record* record = static_cast<diagnostic_record*>(context);
+  record->error = diagnostic->error;
+  record->index = diagnostic->index;
+  record->value.assign(diagnostic->value.data, diagnostic->value.length);
+  record->keywords = diagnostic->keywords;
+}
+
+// Parses a single option with its argument, returning what the parser did.
+int parse_one(const char* arg, values* v, diagnostic_record* record) {
+  const char* argv[] = {"foo.exe", arg};
+  getopt_state state = {0};
+  state.values = v->table;
+  state.diagnose = record_diagnostic;
+  state.diagnose_context = record;
+  return getopt_long_r(count(argv), argv, "j:r:c:t:C::", value_opts, NULL,
+    &state);
+}
+
+}
+
+TEST_F(getopt_fixture, test_getopt_value_conversions) {
+  const char* argv[] = {"foo.exe", "-j", "12", "--ratio=-2.5e-3", "-c4K",
+                        "--timeout", "1.25s", "--color=always"};
+  getopt_spec* spec = getopt_compile("j:r:c:t:C::", value_opts);
+  values v;
+  getopt_state state = {0};
+  state.values = v.table;
+
+  assert_equal('j', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(12, (int)v.jobs);
+  assert_equal('r', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(true, v.ratio == -2.5e-3);
+  assert_equal('c', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(true, v.cache == 4096);
+  assert_equal('t', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(true, v.timeout == 1250000000LL);
+  assert_equal('C', getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+  assert_equal(2, v.color);
+  assert_equal(-1, getopt_compiled_r(count(argv), argv, spec, NULL, &state));
+
+  getopt_spec_free(spec);
+}
+
+TEST_F(getopt_fixture, test_getopt_value_numbers) {
+  values v;
+  diagnostic_record record = {0, 0, "", NULL};
+
+  assert_equal('r', parse_one("--ratio=12345678901234567890.5", &v, &record));
+  assert_equal(true, v.ratio == 12345678901234567890.5);
+  assert_equal('r', parse_one("--ratio=.5", &v, &record));
+  assert_equal(true, v.ratio == 0.5);
+  assert_equal('r', parse_one("--ratio=0.1", &v, &record));
+  assert_equal(true, v.ratio == 0.1);
+  assert_equal('r', parse_one("--ratio=1e300", &v, &record));
+  assert_equal(true, v.ratio == 1e300);
+  assert_equal('c', parse_one("--cache=16777215T", &v, &record));
+  assert_equal(true, v.cache == 16777215ULL << 40);
+  assert_equal('c', parse_one("--cache=3", &v, &record));
+  assert_equal(true, v.cache == 3);
+  assert_equal('t', parse_one("--timeout=250ms", &v, &record));
+  assert_equal(true, v.timeout == 250000000LL);
+  assert_equal('t', parse_one("--timeout=1.5m", &v, &record));
+  assert_equal(true, v.timeout == 90000000000LL);
+  assert_equal('t', parse_one("--timeout=7", &v, &record));
+  assert_equal(true, v.timeout == 7000000000LL);
+  assert_equal('t', parse_one("--timeout=0.0000000019s", &v, &record));
+  assert_equal(true, v.timeout == 1);
+  assert_equal('C', parse_one("--color", &v, &record));
+  assert_equal(-1, v.color);
+  assert_equal(0, record.error);
+}
+
+TEST_F(getopt_fixture, test_getopt_value_double_locale) {
+  // Numbers the fast path cannot convert exactly go to strtod(), which must
+  // still take '.' for the decimal point. Uses a locale with a decimal
+  // comma if one is installed.
+  const char* comma_locales[] = {"de_DE.UTF-8", "de_DE.utf8", "de_DE",
+                                 "fr_FR.UTF-8", "German_Germany.1252"};
+  for (size_t i = 0; i < count(comma_locales); ++i) {
+    if (setlocale(LC_NUMERIC, comma_locales[i]) != NULL)
+      break;
+  }
+
+  values v;
+  diagnostic_record record = {0, 0, "", NULL};
+  assert_equal('r', parse_one("--ratio=1.5e300", &v, &record));
+  assert_equal(true, v.ratio == 1.5e300);
+  assert_equal('r', parse_one("--ratio=-12345678901234567890.25", &v,
+    &record));
+  assert_equal(true, v.ratio == -12345678901234567890.25);
+
+  // Too many digits for the fast path.
+  assert_equal('r', parse_one("--ratio=0.12500000000000000000000000000000"
+    "0000000000000000000000000000000000000000", &v, &record));
+  assert_equal(true, v.ratio == 0.125);
+
+  assert_equal('?', parse_one("--ratio=1,5e300", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--ratio=1.5e999", &v, &record));
+  assert_equal(GETOPT_ERROR_OUT_OF_RANGE, record.error);
+
+  setlocale(LC_NUMERIC, "C");
+}
+
+TEST_F(getopt_fixture, test_getopt_value_errors) {
+  values v;
+  diagnostic_record record = {0, 0, "", NULL};
+
+  assert_equal('?', parse_one("-j0", &v, &record));
+  assert_equal(GETOPT_ERROR_OUT_OF_RANGE, record.error);
+  assert_equal("0", record.value);
+  assert_equal(1, record.index);
+  assert_equal('?', parse_one("--jobs=4x", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal("4x", record.value);
+  assert_equal('?', parse_one("--ratio=1e999", &v, &record));
+  assert_equal(GETOPT_ERROR_OUT_OF_RANGE, record.error);
+  assert_equal('?', parse_one("--ratio=0x10", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--ratio=", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--cache=16777216P", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--cache=16777216T", &v, &record));
+  assert_equal(GETOPT_ERROR_OUT_OF_RANGE, record.error);
+  assert_equal('?', parse_one("--cache=-1", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--timeout=3d", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal('?', parse_one("--timeout=3000000h", &v, &record));
+  assert_equal(GETOPT_ERROR_OUT_OF_RANGE, record.error);
+  assert_equal('?', parse_one("-Cnone", &v, &record));
+  assert_equal(GETOPT_ERROR_INVALID_VALUE, record.error);
+  assert_equal(true, record.keywords == colors);
+  assert_equal('?', parse_one("--color=auto2", &v, &record));
+  assert_equal(-1, v.color);
+
+  // Failed conversions leave the storage alone.
+  assert_equal(true, v.jobs == 0 && v.cache == 0 && v.timeout == 0);
+}
+
+TEST_F(getopt_fixture, test_getopt_value_int_limits) {
+  const char* argv[] = {"foo.exe", "-n", "-9223372036854775808", "-n",
+                        "9223372036854775808"};
+  long long n = 0;
+  getopt_value table[] = {
+    {'n', GETOPT_TYPE_INT, &n, 0, 0, NULL},
+    {0, 0, NULL, 0, 0, NULL}
+  };
+  getopt_state state = {0};
+  state.values = table;
+
+  assert_equal('n', getopt_r(count(argv), argv, "n:", &state));
+  assert_equal(true, n == LLONG_MIN);
+  assert_equal('?', getopt_r(count(argv), argv, "n:", &state));
+  assert_equal('n', state.optopt);
+  assert_equal(true, n == LLONG_MIN);
+}
+
+TEST_F(getopt_fixture, test_getopt_keywords_perfect_hash) {
+  // Enough keywords to fill several buckets, with shared prefixes.
+  std::string storage[200];
+  const char* names[201];
+  for (int i = 0; i < 200; ++i) {
+    storage[i] = "codec" + std::to_string(i * 7);
+    names[i] = storage[i].c_str();
+  }
+  names[200] = NULL;
+
+  getopt_keywords* keywords = getopt_keywords_compile(names);
+  assert_equal(true, keywords != NULL);
+  assert_equal(true, keywords->names == names);
+  for (int i = 0; i < 200; ++i) {
+    assert_equal(i, keywords->lookup(keywords->context, names[i],
+      storage[i].size()));
+  }
+  assert_equal(-1, keywords->lookup(keywords->context, "codec1", 6));
+  assert_equal(-1, keywords->lookup(keywords->context, "codec14", 6));
+  assert_equal(-1, keywords->lookup(keywords->context, "codec14x", 8));
+  assert_equal(-1, keywords->lookup(keywords->context, "", 0));
+  getopt_keywords_free(keywords);
+
+  names[150] = names[3];
+  assert_equal(true, getopt_keywords_compile(names) == NULL);
+
+  names[0] = NULL;
+  keywords = getopt_keywords_compile(names);
+  assert_equal(-1, keywords->lookup(keywords->context, "codec0", 6));
+  getopt_keywords_free(keywords);
+}
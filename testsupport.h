@@ -29,8 +29,14 @@
 #ifndef INCLUDED_TESTSUPPORT_H
 #define INCLUDED_TESTSUPPORT_H
 
-template< int argc >
-static int count(const char* (&argv)[argc]) {
+// Also for argv of other character types.
+template< class CharT, int argc >
+static int count(const CharT* (&argv)[argc]) {
+  return argc;
+}
+
+template< class CharT, int argc >
+static int count(const CharT* const (&argv)[argc]) {
   return argc;
 }
 